@@ -0,0 +1,711 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+// headless driver: reads one case per line and streams the nodal
+// results case by case, without any widget or plotting code
+//
+// input lines are cases in the key=value language of caseparser.h;
+// '#' starts a comment
+//
+// with --study first:last every case is instead solved for a sequence
+// of mesh sizes and compared with the closed form solution, one CSV row
+// per size with the error norms, observed orders and solve time
+//
+// with --calibrate measurements.csv every case is the starting point
+// of a fit of the inputs named by --fit (k by default) to the measured
+// x,T points, one CSV row per fitted input with its 95% interval
+//
+// with --sweep key=first:last:count (or key=v1,v2,...) every case is the
+// base of a ParameterSweep over the given axes of k, q, n, bc_a and
+// bc_b, one CSV row per grid point in grid order
+//
+// with --transient dt:steps[:stride] every case is integrated in time
+// from its uniform t0 by the --scheme (cn or be), one CSV row per node
+// for the initial state, every stride-th step and the last
+//
+// with --grid every case is a 2D rectangle (or r-z section) with the
+// keys a, b, c, d, nx, ny and an edge value or insulated for left,
+// right, bottom and top, one CSV row per grid node
+//
+// --sensitivities adds the columns dT_dk, dT_dq, dT_dbc_a and dT_dbc_b,
+// the derivatives of T at each node in display units; a column is left
+// blank where it does not apply (k and q with layers, k(T))
+//
+// --cache keeps solved cases in a result directory, so repeated cases,
+// also from earlier runs, are read back instead of solved
+//
+// --profile and --trace write the hot path timings of the run as a JSON
+// summary or a Chrome trace, in builds with ENABLE_PROFILING
+
+#include "finiteelementmodel.h"
+#include "finiteelementmodel2d.h"
+#include "caseparser.h"
+#include "convergencestudy.h"
+#include "calibration.h"
+#include "parametersweep.h"
+#include "transientsolver.h"
+#include "profiler.h"
+#include "resultcache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+static void printUsage( const char *prog )
+{
+    std::cerr << "usage: " << prog << " [-i input] [-o output] [--study first:last [--spec tol]]\n"
+              << "       [--calibrate points.csv [--fit k,bc_a]]\n"
+              << "       [--sweep key=first:last:count ... [--threads n]]\n"
+              << "       [--transient dt:steps[:stride] [--scheme cn|be]]\n"
+              << "       [--grid] [--sensitivities] [--cache directory]\n"
+              << "       [--profile summary.json] [--trace trace.json]\n"
+              << "  reads cases from input (default stdin) and writes\n"
+              << "  case,node,x,T,boundary rows as CSV to output (default stdout)\n"
+              << "  --study  convergence study for n = first, 2*first-1, ... up to last,\n"
+              << "           writes case,n,dofs,l2,linf,h1,order_l2,order_linf,order_h1,seconds\n"
+              << "  --spec   max nodal error in display temperature units; the cheapest\n"
+              << "           n meeting it is reported per case on stderr\n"
+              << "  --calibrate  fit each case to measured x,T points, writes\n"
+              << "           case,parameter,value,std_error,lower,upper,rms,iterations,solves\n"
+              << "  --fit    inputs to fit, any of k, q, bc_a, bc_b (default k)\n"
+              << "  --sweep  solve each case over a grid of k, q, n, bc_a, bc_b values,\n"
+              << "           key=first:last:count or key=v1,v2,..., repeat for more axes;\n"
+              << "           writes case,k,q,n,bc_a,bc_b,T_min,T_max,boundary_a,boundary_b\n"
+              << "  --threads  sweep or grid assembly threads, default one per core\n"
+              << "  --transient  integrate each case in time from t0 with steps of dt s,\n"
+              << "           writes case,step,time,node,x,T every stride steps\n"
+              << "  --scheme  cn (Crank-Nicolson, default) or be (backward Euler)\n"
+              << "  --grid   cases are 2D grids, writes case,i,j,x,y,T\n"
+              << "  --sensitivities  add dT_dk,dT_dq,dT_dbc_a,dT_dbc_b columns\n"
+              << "  --cache  reuse solutions stored in directory and store new ones\n"
+              << "  --profile  per phase totals as JSON\n"
+              << "  --trace    every timed interval in Chrome trace format\n";
+}
+
+static bool parseStudyRange( const char *text, int &first, int &last )
+{
+    char *end = nullptr;
+    first = (int)std::strtol(text, &end, 10);
+    if (end == text || *end != ':')
+    {
+        return false;
+    }
+    const char *rest = end + 1;
+    last = (int)std::strtol(rest, &end, 10);
+    return end != rest && *end == '\0' && first >= 2 && last >= first;
+}
+
+// errors are converted to display units; they are differences, so only
+// the scale applies, with the length measure folded into L2 and H1
+static void writeStudy( FILE *out, long caseIndex, FiniteElementModel &model,
+                        const std::vector<ConvergenceResult> &results )
+{
+    const UnitScales &u = model.get_unit_scales();
+    double tScale = u.temperature.scale;
+    double lRoot = std::sqrt(u.length.scale);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ConvergenceResult &r = results[i];
+        std::fprintf(out, "%ld,%d,%d,%.6e,%.6e,%.6e,%.4f,%.4f,%.4f,%.6e\n", caseIndex, r.n, r.dofs,
+                     r.error.l2*tScale*lRoot, r.error.linf*tScale, r.error.h1*tScale/lRoot,
+                     r.orderL2, r.orderLinf, r.orderH1, r.seconds);
+    }
+}
+
+static void writeCalibration( FILE *out, long caseIndex, const CalibrationResult &r )
+{
+    for (size_t i = 0; i < r.values.size(); i++)
+    {
+        const CalibratedValue &v = r.values[i];
+        std::fprintf(out, "%ld,%s,%.12g,%.6e,%.12g,%.12g,%.6e,%d,%d\n", caseIndex,
+                     Calibration::parameterName(v.parameter), v.value, v.standardError,
+                     v.lower, v.upper, r.rms, r.iterations, r.solves);
+    }
+}
+
+static bool parseTransient( const char *text, double &dt, int &steps, int &stride )
+{
+    char *end = nullptr;
+    dt = std::strtod(text, &end);
+    if (end == text || *end != ':' || !std::isfinite(dt) || !(dt > 0.0))
+    {
+        return false;
+    }
+    const char *field = end + 1;
+    steps = (int)std::strtol(field, &end, 10);
+    if (end == field || steps < 1)
+    {
+        return false;
+    }
+    stride = 1;
+    if (*end == ':')
+    {
+        field = end + 1;
+        stride = (int)std::strtol(field, &end, 10);
+        if (end == field || stride < 1)
+        {
+            return false;
+        }
+    }
+    return *end == '\0';
+}
+
+// key=first:last:count or key=v1,v2,... for one sweep axis; values
+// the case parser would refuse are refused here as well
+static bool parseSweepAxis( const char *text, SweepParameter &which, std::vector<double> &values )
+{
+    static const std::pair<const char *, SweepParameter> keys[] = {
+        { "k", SweepParameter::K }, { "q", SweepParameter::Q }, { "n", SweepParameter::N },
+        { "bc_a", SweepParameter::BC_A }, { "bc_b", SweepParameter::BC_B } };
+    const char *eq = std::strchr(text, '=');
+    if (eq == nullptr)
+    {
+        return false;
+    }
+    std::string key(text, eq - text);
+    bool found = false;
+    for (const auto &k : keys)
+    {
+        if (key == k.first)
+        {
+            which = k.second;
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    values.clear();
+    const char *field = eq + 1;
+    char *rest = nullptr;
+    double first = std::strtod(field, &rest);
+    if (rest != field && *rest == ':')
+    {
+        field = rest + 1;
+        double last = std::strtod(field, &rest);
+        if (rest == field || *rest != ':')
+        {
+            return false;
+        }
+        field = rest + 1;
+        long count = std::strtol(field, &rest, 10);
+        if (rest == field || *rest != '\0' || count < 1 || count > 100000)
+        {
+            return false;
+        }
+        for (long i = 0; i < count; i++)
+        {
+            double value = (count == 1) ? first : first + (last - first)*i/(count - 1);
+            values.push_back( (which == SweepParameter::N) ? std::round(value) : value );
+        }
+    }
+    else
+    {
+        while (true)
+        {
+            double value = std::strtod(field, &rest);
+            if (rest == field || (*rest != ',' && *rest != '\0'))
+            {
+                return false;
+            }
+            values.push_back(value);
+            if (*rest == '\0')
+            {
+                break;
+            }
+            field = rest + 1;
+        }
+    }
+    for (double v : values)
+    {
+        if (!std::isfinite(v) || (which == SweepParameter::K && !(v > 0.0))
+            || (which == SweepParameter::N && !(v >= 2.0 && v <= maxCaseNodes && v == std::floor(v))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void writeSweep( FILE *out, long caseIndex, const std::vector<SweepResult> &results )
+{
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SweepResult &r = results[i];
+        std::fprintf(out, "%ld,%.12g,%.12g,%d,%.12g,%.12g,%.12g,%.12g,%.12g,%.12g\n", caseIndex,
+                     r.point.k, r.point.q, r.point.n, r.point.bc_a, r.point.bc_b,
+                     r.minTemperature, r.maxTemperature, r.boundaryFluxA, r.boundaryFluxB);
+    }
+}
+
+static void writeGrid( FILE *out, long caseIndex, const FiniteElementSolution2D &sol )
+{
+    int nx = sol.nodalXVals.size();
+    for (int j = 0; j < sol.nodalYVals.size(); j++)
+    {
+        for (int i = 0; i < nx; i++)
+        {
+            std::fprintf(out, "%ld,%d,%d,%.12g,%.12g,%.12g\n", caseIndex, i, j,
+                         sol.nodalXVals(i), sol.nodalYVals(j), sol.nodalSolution(j*nx + i));
+        }
+    }
+}
+
+static void writeSensitivity( FILE *out, const VectorXd &values, int i )
+{
+    if (i < values.size())
+    {
+        std::fprintf(out, ",%.12g", values(i));
+    }
+    else
+    {
+        std::fputc(',', out);
+    }
+}
+
+static void writeCase( FILE *out, long caseIndex, const FiniteElementSolution &sol, bool sensitivities )
+{
+    PROFILE_SCOPE("batch.write");
+    int n = sol.nodalSolution.size();
+    for (int i = 0; i < n; i++)
+    {
+        std::fprintf(out, "%ld,%d,%.12g,%.12g,%.12g", caseIndex, i,
+                     sol.nodalXVals(i), sol.nodalSolution(i), sol.boundaryValues(i));
+        if (sensitivities)
+        {
+            writeSensitivity(out, sol.sensitivities.k, i);
+            writeSensitivity(out, sol.sensitivities.q, i);
+            writeSensitivity(out, sol.sensitivities.bc_a, i);
+            writeSensitivity(out, sol.sensitivities.bc_b, i);
+        }
+        std::fputc('\n', out);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *inputName = nullptr;
+    const char *outputName = nullptr;
+    int studyFirst = 0;
+    int studyLast = 0;
+    double spec = 0.0;
+    const char *profileName = nullptr;
+    const char *traceName = nullptr;
+    const char *cacheName = nullptr;
+    bool sensitivities = false;
+    const char *calibrateName = nullptr;
+    std::vector<CalibrationParameter> fitted = { CalibrationParameter::K };
+    std::vector< std::pair<SweepParameter, std::vector<double> > > sweepAxes;
+    int threads = 0;
+    double transientStep = 0.0;
+    int transientSteps = 0;
+    int transientStride = 1;
+    TimeScheme scheme = TimeScheme::CRANK_NICOLSON;
+    bool grid = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-i") == 0 && i+1 < argc)
+        {
+            inputName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-o") == 0 && i+1 < argc)
+        {
+            outputName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--study") == 0 && i+1 < argc
+                 && parseStudyRange(argv[i+1], studyFirst, studyLast))
+        {
+            i++;
+        }
+        else if (std::strcmp(argv[i], "--spec") == 0 && i+1 < argc)
+        {
+            spec = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0 && i+1 < argc)
+        {
+            profileName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && i+1 < argc)
+        {
+            traceName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--calibrate") == 0 && i+1 < argc)
+        {
+            calibrateName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--fit") == 0 && i+1 < argc)
+        {
+            std::string error;
+            if (!Calibration::parseParameters(argv[++i], fitted, error))
+            {
+                std::cerr << error << "\n";
+                return 2;
+            }
+        }
+        else if (std::strcmp(argv[i], "--sweep") == 0 && i+1 < argc)
+        {
+            std::pair<SweepParameter, std::vector<double> > axis;
+            if (!parseSweepAxis(argv[++i], axis.first, axis.second))
+            {
+                std::cerr << "bad sweep axis '" << argv[i] << "'\n";
+                return 2;
+            }
+            sweepAxes.push_back(axis);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+        {
+            threads = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--transient") == 0 && i+1 < argc)
+        {
+            if (!parseTransient(argv[++i], transientStep, transientSteps, transientStride))
+            {
+                std::cerr << "bad time stepping '" << argv[i] << "'\n";
+                return 2;
+            }
+        }
+        else if (std::strcmp(argv[i], "--scheme") == 0 && i+1 < argc)
+        {
+            i++;
+            if (std::strcmp(argv[i], "cn") == 0)
+            {
+                scheme = TimeScheme::CRANK_NICOLSON;
+            }
+            else if (std::strcmp(argv[i], "be") == 0)
+            {
+                scheme = TimeScheme::BACKWARD_EULER;
+            }
+            else
+            {
+                std::cerr << "unknown scheme '" << argv[i] << "'\n";
+                return 2;
+            }
+        }
+        else if (std::strcmp(argv[i], "--grid") == 0)
+        {
+            grid = true;
+        }
+        else if (std::strcmp(argv[i], "--sensitivities") == 0)
+        {
+            sensitivities = true;
+        }
+        else if (std::strcmp(argv[i], "--cache") == 0 && i+1 < argc)
+        {
+            cacheName = argv[++i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::ifstream inputFile;
+    std::istream *in = &std::cin;
+    if (inputName != nullptr && std::strcmp(inputName, "-") != 0)
+    {
+        inputFile.open(inputName);
+        if (!inputFile)
+        {
+            std::cerr << "cannot open input file " << inputName << "\n";
+            return 1;
+        }
+        in = &inputFile;
+    }
+
+    FILE *out = stdout;
+    if (outputName != nullptr && std::strcmp(outputName, "-") != 0)
+    {
+        out = std::fopen(outputName, "w");
+        if (out == nullptr)
+        {
+            std::cerr << "cannot open output file " << outputName << "\n";
+            return 1;
+        }
+    }
+    // large output buffer, results are written in big blocks
+    static char outBuffer[1 << 16];
+    std::setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+    std::ios::sync_with_stdio(false);
+
+    ResultCache cache;
+    std::string cacheError;
+    if (cacheName != nullptr && !cache.set_directory(cacheName, cacheError))
+    {
+        std::cerr << cacheError << "\n";
+        return 1;
+    }
+
+    std::vector<Measurement> measurements;
+    std::string measurementError;
+    if (calibrateName != nullptr
+        && !Calibration::readMeasurements(calibrateName, measurements, measurementError))
+    {
+        std::cerr << measurementError << "\n";
+        return 1;
+    }
+
+    bool study = (studyLast > 0);
+    if (grid)
+    {
+        std::fprintf(out, "case,i,j,x,y,T\n");
+    }
+    else if (study)
+    {
+        std::fprintf(out, "case,n,dofs,l2,linf,h1,order_l2,order_linf,order_h1,seconds\n");
+    }
+    else if (transientSteps > 0)
+    {
+        std::fprintf(out, "case,step,time,node,x,T\n");
+    }
+    else if (!sweepAxes.empty())
+    {
+        std::fprintf(out, "case,k,q,n,bc_a,bc_b,T_min,T_max,boundary_a,boundary_b\n");
+    }
+    else if (calibrateName != nullptr)
+    {
+        std::fprintf(out, "case,parameter,value,std_error,lower,upper,rms,iterations,solves\n");
+    }
+    else
+    {
+        std::fprintf(out, sensitivities ? "case,node,x,T,boundary,dT_dk,dT_dq,dT_dbc_a,dT_dbc_b\n"
+                                        : "case,node,x,T,boundary\n");
+    }
+
+    int status = 0;
+    long lineNumber = 0;
+    long caseIndex = 0;
+    std::string line;
+    while (std::getline(*in, line))
+    {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+
+        // each case gets a fresh model so nothing carries over
+        caseIndex++;
+        if (grid)
+        {
+            FiniteElementModel2D model2d;
+            std::string error;
+            if (!parseCase(line, model2d, error))
+            {
+                std::cerr << "line " << lineNumber << ": " << error << ", case " << caseIndex << " skipped\n";
+                status = 1;
+                continue;
+            }
+            model2d.set_threads(threads);
+            FiniteElementSolution2D sol = model2d.findNodalSolution();
+            if (sol.cancelled)
+            {
+                std::cerr << "case " << caseIndex << ": not solved\n";
+                status = 1;
+                continue;
+            }
+            if (!sol.nodalSolution.allFinite())
+            {
+                std::cerr << "case " << caseIndex << ": solution is not finite\n";
+                status = 1;
+                continue;
+            }
+            if (!sol.stats.converged)
+            {
+                std::cerr << "case " << caseIndex << ": linear solve failed or not converged\n";
+                status = 1;
+            }
+            model2d.convertToDisplayUnits(sol);
+            writeGrid(out, caseIndex, sol);
+            continue;
+        }
+
+        FiniteElementModel model;
+        std::string error;
+        if (!parseCase(line, model, error))
+        {
+            std::cerr << "line " << lineNumber << ": " << error << ", case " << caseIndex << " skipped\n";
+            status = 1;
+            continue;
+        }
+
+        if (study)
+        {
+            ConvergenceStudy convergence(model);
+            convergence.set_range(studyFirst, studyLast);
+            std::vector<ConvergenceResult> results = convergence.run();
+            writeStudy(out, caseIndex, model, results);
+            if (spec > 0.0)
+            {
+                double tolerance = spec/model.get_unit_scales().temperature.scale;
+                int best = ConvergenceStudy::cheapest(results, tolerance);
+                if (best > 0)
+                {
+                    std::cerr << "case " << caseIndex << ": n=" << best << " meets the spec\n";
+                }
+                else
+                {
+                    std::cerr << "case " << caseIndex << ": no n up to " << studyLast << " meets the spec\n";
+                }
+            }
+            continue;
+        }
+
+        if (transientSteps > 0)
+        {
+            TransientSolver transient(model);
+            if (!transient.get_error().empty())
+            {
+                std::cerr << "case " << caseIndex << ": " << transient.get_error() << "\n";
+                status = 1;
+                continue;
+            }
+            transient.set_scheme(scheme);
+            transient.set_time_step(transientStep);
+            transient.set_stride(transientStride);
+            // the sink sees SI values, converted the way a solution is
+            FiniteElementSolution snapshot;
+            snapshot.nodalXVals = transient.get_x_vals();
+            model.convertToDisplayUnits(snapshot);
+            const VectorXd x = snapshot.nodalXVals;
+            transient.set_sink( [&](int step, double time, const VectorXd &nodalSolution)
+            {
+                snapshot.nodalXVals.resize(0);
+                snapshot.nodalSolution = nodalSolution;
+                model.convertToDisplayUnits(snapshot);
+                for (int i = 0; i < snapshot.nodalSolution.size(); i++)
+                {
+                    std::fprintf(out, "%ld,%d,%.12g,%d,%.12g,%.12g\n", caseIndex, step, time, i,
+                                 x(i), snapshot.nodalSolution(i));
+                }
+            });
+            transient.run(transientSteps);
+            continue;
+        }
+
+        if (!sweepAxes.empty())
+        {
+            ParameterSweep sweep(model);
+            for (size_t a = 0; a < sweepAxes.size(); a++)
+            {
+                sweep.set_values(sweepAxes[a].first, sweepAxes[a].second);
+            }
+            sweep.set_threads(threads);
+            writeSweep(out, caseIndex, sweep.run());
+            continue;
+        }
+
+        if (calibrateName != nullptr)
+        {
+            Calibration calibration(model);
+            calibration.set_measurements(measurements);
+            calibration.set_parameters(fitted);
+            CalibrationResult result = calibration.run();
+            if (!result.ok)
+            {
+                std::cerr << "case " << caseIndex << ": " << result.error << "\n";
+                status = 1;
+                continue;
+            }
+            if (!result.converged)
+            {
+                std::cerr << "case " << caseIndex << ": calibration not converged after "
+                          << result.iterations << " iterations\n";
+                status = 1;
+            }
+            writeCalibration(out, caseIndex, result);
+            continue;
+        }
+
+        model.set_sensitivities(sensitivities);
+        std::shared_ptr<const FiniteElementSolution> cached;
+        if (cacheName != nullptr)
+        {
+            cached = cache.find(model);
+        }
+        FiniteElementSolution sol = cached ? *cached : model.findNodalSolution();
+        if (cacheName != nullptr && !cached)
+        {
+            cache.insert(model, std::make_shared<const FiniteElementSolution>(sol));
+        }
+        if (!sol.nodalSolution.allFinite() || !sol.boundaryValues.allFinite())
+        {
+            std::cerr << "case " << caseIndex << ": solution is not finite"
+                      << (model.has_conductivity_curve() ? ", k(T) is not positive at the temperatures reached\n"
+                                                         : "\n");
+            status = 1;
+            continue;
+        }
+        if (!sol.nonlinearHistory.empty() && !sol.stats.converged)
+        {
+            std::cerr << "case " << caseIndex << ": k(T) iteration not converged after "
+                      << sol.stats.iterations << " iterations\n";
+            status = 1;
+        }
+        else if (!sol.stats.converged)
+        {
+            std::cerr << "case " << caseIndex << ": linear solve failed or not converged\n";
+            status = 1;
+        }
+        model.convertToDisplayUnits(sol);
+        writeCase(out, caseIndex, sol, sensitivities);
+    }
+
+    std::fflush(out);
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    if (cacheName != nullptr)
+    {
+        ResultCacheStats c = cache.stats();
+        std::cerr << "cache: " << c.hits << " hits (" << c.diskHits << " from disk), "
+                  << c.misses << " misses\n";
+    }
+
+    if ((profileName != nullptr || traceName != nullptr) && !Profiler::enabled())
+    {
+        std::cerr << "built without ENABLE_PROFILING, the profile is empty\n";
+    }
+    std::string error;
+    if (profileName != nullptr && !Profiler::instance().writeSummaryJson(profileName, error))
+    {
+        std::cerr << error << "\n";
+        status = 1;
+    }
+    if (traceName != nullptr && !Profiler::instance().writeChromeTrace(traceName, error))
+    {
+        std::cerr << error << "\n";
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,582 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+// benchmark driver: times the phases of findNodalSolution() over a
+// range of mesh sizes and writes the results as JSON, one case per
+// line, so two runs can be diffed or compared with --baseline
+//
+// phases, all reported in ns per node (per degree of freedom):
+//   assembly       element loop and global load
+//   factorization  matrix factorization or preconditioner setup
+//   solve          forward/back substitution or iterations
+//   postprocess    boundary values K*T - F
+//   solution       the rest of building FiniteElementSolution
+//   total          one cold solve, measured from outside
+//   resolve        a solve after changing q only (cached factorization)
+//
+// --rods instead compares RodBatchSolver with one FiniteElementModel
+// solve per rod, in million nodes per second
+
+#include "finiteelementmodel.h"
+#include "rodbatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// count heap allocations by interposing on malloc; operator new and
+// Eigen both end up here. Only done on glibc, elsewhere the count is
+// reported as -1.
+static std::atomic<long> allocationCount(0);
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t count, size_t size );
+extern "C" void *__libc_realloc( void *ptr, size_t size );
+
+extern "C" void *malloc( size_t size ) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc( size_t count, size_t size ) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc( void *ptr, size_t size ) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+static const bool countingAllocations = true;
+#else
+static const bool countingAllocations = false;
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+// reset the peak resident set size where Linux allows it, so every
+// case reports its own peak instead of the largest so far
+static void resetPeakMemory()
+{
+    FILE *f = std::fopen("/proc/self/clear_refs", "w");
+    if (f != nullptr)
+    {
+        std::fputs("5", f);
+        std::fclose(f);
+    }
+}
+
+static long peakMemoryKb()
+{
+    FILE *f = std::fopen("/proc/self/status", "r");
+    if (f != nullptr)
+    {
+        char line[256];
+        long kb = -1;
+        while (std::fgets(line, sizeof(line), f) != nullptr)
+        {
+            if (std::strncmp(line, "VmHWM:", 6) == 0)
+            {
+                kb = std::atol(line + 6);
+                break;
+            }
+        }
+        std::fclose(f);
+        if (kb >= 0)
+        {
+            return kb;
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// one measured case; times are in ns per node
+typedef struct
+{
+    std::string coord;
+    long n;
+    long dofs;
+    int reps;
+    double assembly;
+    double factorization;
+    double solve;
+    double postprocess;
+    double solution;
+    double total;
+    double resolve;
+    long allocations; // per cold solve
+    long resolveAllocations; // per re-solve
+    long peakRssKb;
+}
+BenchCase;
+
+static const char *phaseNames[] = { "assembly", "factorization", "solve", "postprocess",
+                                    "solution", "total", "resolve" };
+static const int numPhases = 7;
+
+static double *phase( BenchCase &c, int i )
+{
+    double *phases[] = { &c.assembly, &c.factorization, &c.solve, &c.postprocess,
+                         &c.solution, &c.total, &c.resolve };
+    return phases[i];
+}
+
+static BenchCase runCase( const FiniteElementModel &prototype, const char *coord, long n )
+{
+    BenchCase c;
+    c.coord = coord;
+    c.n = n;
+
+    // enough repetitions for about 2e6 nodes per case, the minimum of
+    // every phase is kept
+    c.reps = (int)std::max(1L, std::min(1000L, 2000000L/n));
+    double best[numPhases];
+    std::fill(best, best + numPhases, 1e300);
+
+    resetPeakMemory();
+    for (int r = 0; r < c.reps; r++)
+    {
+        // a fresh copy has no cached factorization, so this is a cold solve
+        FiniteElementModel model = prototype;
+        long allocBefore = allocationCount.load();
+        Clock::time_point t0 = Clock::now();
+        FiniteElementSolution sol = model.findNodalSolution();
+        double total = secondsSince(t0);
+        long allocs = allocationCount.load() - allocBefore;
+
+        const SolverStatistics &s = sol.stats;
+        double parts[numPhases] = { s.assemblyTime, s.factorizationTime, s.solveTime,
+                                    s.postProcessTime, 0.0, total, 0.0 };
+        parts[4] = total - s.assemblyTime - s.factorizationTime - s.solveTime - s.postProcessTime;
+        c.dofs = sol.nodalSolution.size();
+
+        // same model again with only q changed
+        model.set_q( model.get_q()*1.5 );
+        allocBefore = allocationCount.load();
+        t0 = Clock::now();
+        FiniteElementSolution again = model.findNodalSolution();
+        parts[6] = secondsSince(t0);
+        long resolveAllocs = allocationCount.load() - allocBefore;
+
+        for (int i = 0; i < numPhases; i++)
+        {
+            best[i] = std::min(best[i], parts[i]);
+        }
+        if (r == 0)
+        {
+            c.allocations = countingAllocations ? allocs : -1;
+            c.resolveAllocations = countingAllocations ? resolveAllocs : -1;
+        }
+    }
+    for (int i = 0; i < numPhases; i++)
+    {
+        *phase(c, i) = 1e9*std::max(best[i], 0.0)/c.dofs;
+    }
+    c.peakRssKb = peakMemoryKb();
+    return c;
+}
+
+static void writeCase( FILE *out, const BenchCase &c, bool last )
+{
+    std::fprintf(out, "    {\"coord\": \"%s\", \"n\": %ld, \"dofs\": %ld, \"reps\": %d",
+                 c.coord.c_str(), c.n, c.dofs, c.reps);
+    for (int i = 0; i < numPhases; i++)
+    {
+        std::fprintf(out, ", \"%s_ns_per_node\": %.4g", phaseNames[i],
+                     *phase(const_cast<BenchCase &>(c), i));
+    }
+    std::fprintf(out, ", \"allocations\": %ld, \"resolve_allocations\": %ld, \"peak_rss_kb\": %ld}%s\n",
+                 c.allocations, c.resolveAllocations, c.peakRssKb, last ? "" : ",");
+}
+
+// the baseline is a file written by this tool, one case per line, so
+// looking up "key": on the line is all the parsing needed
+static bool findNumber( const std::string &line, const std::string &key, double &value )
+{
+    size_t pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    const char *start = line.c_str() + pos + key.size() + 3;
+    char *end = nullptr;
+    value = std::strtod(start, &end);
+    return end != start;
+}
+
+static bool findString( const std::string &line, const std::string &key, std::string &value )
+{
+    size_t pos = line.find("\"" + key + "\": \"");
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    size_t start = pos + key.size() + 5;
+    size_t end = line.find('"', start);
+    if (end == std::string::npos)
+    {
+        return false;
+    }
+    value = line.substr(start, end - start);
+    return true;
+}
+
+static bool readBaseline( const char *name, std::vector<BenchCase> &cases )
+{
+    std::ifstream in(name);
+    if (!in)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        BenchCase c;
+        double n, allocations;
+        if (!findString(line, "coord", c.coord) || !findNumber(line, "n", n))
+        {
+            continue;
+        }
+        c.n = (long)n;
+        for (int i = 0; i < numPhases; i++)
+        {
+            double *value = phase(c, i);
+            if (!findNumber(line, std::string(phaseNames[i]) + "_ns_per_node", *value))
+            {
+                *value = -1.0;
+            }
+        }
+        c.allocations = findNumber(line, "allocations", allocations) ? (long)allocations : -1;
+        cases.push_back(c);
+    }
+    return true;
+}
+
+// flags every phase that got slower than the threshold allows, and
+// ignores differences under floorNs per solve which are only noise
+static int compareWithBaseline( const std::vector<BenchCase> &baseline, std::vector<BenchCase> &current,
+                                double threshold, double floorNs )
+{
+    int regressions = 0;
+    for (size_t k = 0; k < current.size(); k++)
+    {
+        BenchCase &now = current[k];
+        for (size_t j = 0; j < baseline.size(); j++)
+        {
+            BenchCase before = baseline[j];
+            if (before.coord != now.coord || before.n != now.n)
+            {
+                continue;
+            }
+            for (int i = 0; i < numPhases; i++)
+            {
+                double oldValue = *phase(before, i);
+                double newValue = *phase(now, i);
+                if (oldValue < 0.0)
+                {
+                    continue;
+                }
+                bool slower = newValue > oldValue*(1.0 + threshold)
+                              && (newValue - oldValue)*now.dofs > floorNs;
+                if (slower)
+                {
+                    std::fprintf(stderr, "REGRESSION %s n=%ld %s: %.4g -> %.4g ns/node (%+.1f%%)\n",
+                                 now.coord.c_str(), now.n, phaseNames[i], oldValue, newValue,
+                                 100.0*(newValue/oldValue - 1.0));
+                    regressions++;
+                }
+            }
+            if (before.allocations >= 0 && now.allocations > before.allocations)
+            {
+                std::fprintf(stderr, "REGRESSION %s n=%ld allocations: %ld -> %ld\n",
+                             now.coord.c_str(), now.n, before.allocations, now.allocations);
+                regressions++;
+            }
+            break;
+        }
+    }
+    return regressions;
+}
+
+static void printUsage( const char *prog )
+{
+    std::cerr << "usage: " << prog << " [-o output] [--min-n N] [--max-n N]\n"
+              << "       [--solver banded|ldlt|cg|cg-ichol|bicgstab] [--element linear|quadratic|cubic]\n"
+              << "       [--baseline old.json] [--threshold 0.10] [--floor-ns 1000]\n"
+              << "       [--rods count]\n"
+              << "  times the solve phases for n = 10, 100, ... up to max-n (default 1e7)\n"
+              << "  in both coordinate systems and writes JSON to output (default stdout);\n"
+              << "  with a baseline, slower phases are reported and the exit status is 1;\n"
+              << "  --rods times batched solves of count short rods instead\n";
+}
+
+// count rods of n nodes with varying length, k, q and boundary values,
+// solved batched and one model at a time
+static void runRods( FILE *out, long count )
+{
+    const int sizes[] = { 10, 50, 200 };
+    const char *coordNames[] = { "cartesian", "cylindrical" };
+    const CoordType coords[] = { CoordType::CARTESIAN, CoordType::CYLINDRICAL };
+
+    RodBatchInputs inputs;
+    inputs.a = Eigen::ArrayXd::Constant(count, 0.05);
+    inputs.b = inputs.a + 0.5 + 0.25*Eigen::ArrayXd::Random(count);
+    inputs.bc_a = 500.0 + 100.0*Eigen::ArrayXd::Random(count);
+    inputs.bc_b = 300.0 + 100.0*Eigen::ArrayXd::Random(count);
+    inputs.k = 20.0 + 15.0*Eigen::ArrayXd::Random(count);
+    inputs.q = 1.0e4 + 1.0e4*Eigen::ArrayXd::Random(count);
+
+    std::fprintf(out, "{\n  \"benchmark\": \"varmacalc-rods\",\n  \"rods\": %ld,\n  \"cases\": [\n", count);
+    for (int c = 0; c < 2; c++)
+    {
+        for (int s = 0; s < 3; s++)
+        {
+            int n = sizes[s];
+            RodBatchSolver batch;
+            batch.set_n(n);
+            batch.set_coord(coords[c]);
+            batch.solve(inputs); // warm up, first touch of the results
+            Clock::time_point t0 = Clock::now();
+            batch.solve(inputs);
+            double batched = (double)count*n/secondsSince(t0)/1.0e6;
+
+            // the same rods through the model, capped to keep it short
+            long single = std::min(count, 20000L);
+            FiniteElementModel model;
+            model.set_coord(coords[c]);
+            model.set_n(n);
+            t0 = Clock::now();
+            for (long r = 0; r < single; r++)
+            {
+                model.set_a(inputs.a(r));
+                model.set_b(inputs.b(r));
+                model.set_bc_a(inputs.bc_a(r));
+                model.set_bc_b(inputs.bc_b(r));
+                model.set_k(inputs.k(r));
+                model.set_q(inputs.q(r));
+                model.findNodalSolution();
+            }
+            double oneByOne = (double)single*n/secondsSince(t0)/1.0e6;
+
+            std::fprintf(out, "    {\"coord\": \"%s\", \"n\": %d, \"batched_mnodes_per_s\": %.1f, "
+                              "\"model_mnodes_per_s\": %.1f}%s\n", coordNames[c], n, batched, oneByOne,
+                         (c == 1 && s == 2) ? "" : ",");
+            std::fprintf(stderr, "%-11s n=%-4d batched %8.1f  model %6.1f Mnodes/s\n",
+                         coordNames[c], n, batched, oneByOne);
+        }
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+static bool parseSolver( const char *name, SolverType &solver )
+{
+    static const char *names[] = { "banded", "ldlt", "cg", "cg-ichol", "bicgstab" };
+    static const SolverType types[] = { SolverType::BANDED, SolverType::SPARSE_LDLT,
+        SolverType::CG_JACOBI, SolverType::CG_ICHOL, SolverType::BICGSTAB };
+    for (int i = 0; i < 5; i++)
+    {
+        if (std::strcmp(name, names[i]) == 0)
+        {
+            solver = types[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseElement( const char *name, ElementType &element )
+{
+    static const char *names[] = { "linear", "quadratic", "cubic" };
+    static const ElementType types[] = { ElementType::LINEAR, ElementType::QUADRATIC,
+        ElementType::CUBIC };
+    for (int i = 0; i < 3; i++)
+    {
+        if (std::strcmp(name, names[i]) == 0)
+        {
+            element = types[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputName = nullptr;
+    const char *baselineName = nullptr;
+    const char *solverName = "banded";
+    const char *elementName = "linear";
+    double threshold = 0.10;
+    double floorNs = 1000.0;
+    long minN = 10;
+    long maxN = 10000000;
+    long rods = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = (i+1 < argc);
+        if (std::strcmp(argv[i], "-o") == 0 && hasValue)
+        {
+            outputName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--baseline") == 0 && hasValue)
+        {
+            baselineName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--threshold") == 0 && hasValue)
+        {
+            threshold = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--floor-ns") == 0 && hasValue)
+        {
+            floorNs = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--min-n") == 0 && hasValue)
+        {
+            minN = std::max(2L, (long)std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--max-n") == 0 && hasValue)
+        {
+            maxN = (long)std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--solver") == 0 && hasValue)
+        {
+            solverName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--element") == 0 && hasValue)
+        {
+            elementName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--rods") == 0 && hasValue)
+        {
+            rods = std::max(1L, (long)std::atof(argv[++i]));
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    SolverType solver;
+    ElementType element;
+    if (!parseSolver(solverName, solver) || !parseElement(elementName, element))
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    if (rods > 0)
+    {
+        FILE *out = stdout;
+        if (outputName != nullptr && std::strcmp(outputName, "-") != 0)
+        {
+            out = std::fopen(outputName, "w");
+            if (out == nullptr)
+            {
+                std::cerr << "cannot open output file " << outputName << "\n";
+                return 1;
+            }
+        }
+        runRods(out, rods);
+        if (out != stdout)
+        {
+            std::fclose(out);
+        }
+        return 0;
+    }
+
+    std::vector<BenchCase> baseline;
+    if (baselineName != nullptr && !readBaseline(baselineName, baseline))
+    {
+        std::cerr << "cannot open baseline file " << baselineName << "\n";
+        return 1;
+    }
+
+    std::vector<BenchCase> cases;
+    const char *coordNames[] = { "cartesian", "cylindrical" };
+    const CoordType coords[] = { CoordType::CARTESIAN, CoordType::CYLINDRICAL };
+    for (long n = minN; n <= maxN; n *= 10)
+    {
+        for (int c = 0; c < 2; c++)
+        {
+            FiniteElementModel prototype;
+            prototype.set_coord(coords[c]);
+            prototype.set_solver(solver);
+            prototype.set_element(element);
+            prototype.set_n( (int)n );
+            cases.push_back( runCase(prototype, coordNames[c], n) );
+            std::fprintf(stderr, "%-11s n=%-9ld total %8.2f ns/node\n",
+                         coordNames[c], n, cases.back().total);
+        }
+    }
+
+    FILE *out = stdout;
+    if (outputName != nullptr && std::strcmp(outputName, "-") != 0)
+    {
+        out = std::fopen(outputName, "w");
+        if (out == nullptr)
+        {
+            std::cerr << "cannot open output file " << outputName << "\n";
+            return 1;
+        }
+    }
+    std::fprintf(out, "{\n  \"benchmark\": \"varmacalc\",\n  \"solver\": \"%s\",\n"
+                      "  \"element\": \"%s\",\n  \"cases\": [\n", solverName, elementName);
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        writeCase(out, cases[i], i+1 == cases.size());
+    }
+    std::fprintf(out, "  ]\n}\n");
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    if (baselineName != nullptr)
+    {
+        int regressions = compareWithBaseline(baseline, cases, threshold, floorNs);
+        std::fprintf(stderr, "%d regression(s) against %s (threshold %.0f%%)\n",
+                     regressions, baselineName, 100.0*threshold);
+        return (regressions > 0) ? 1 : 0;
+    }
+    return 0;
+}
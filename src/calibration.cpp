@@ -0,0 +1,537 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "calibration.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
+
+using Eigen::MatrixXd;
+
+static double getParameter( FiniteElementModel &model, CalibrationParameter which )
+{
+    switch (which)
+    {
+    case CalibrationParameter::K:
+        return model.get_k();
+    case CalibrationParameter::Q:
+        return model.get_q();
+    case CalibrationParameter::BC_A:
+        return model.get_bc_a();
+    default:
+        return model.get_bc_b();
+    }
+}
+
+static void setParameter( FiniteElementModel &model, CalibrationParameter which, double value )
+{
+    switch (which)
+    {
+    case CalibrationParameter::K:
+        model.set_k(value);
+        break;
+    case CalibrationParameter::Q:
+        model.set_q(value);
+        break;
+    case CalibrationParameter::BC_A:
+        model.set_bc_a(value);
+        break;
+    default:
+        model.set_bc_b(value);
+        break;
+    }
+}
+
+static const VectorXd &sensitivity( const FiniteElementSolution &sol, CalibrationParameter which )
+{
+    switch (which)
+    {
+    case CalibrationParameter::K:
+        return sol.sensitivities.k;
+    case CalibrationParameter::Q:
+        return sol.sensitivities.q;
+    case CalibrationParameter::BC_A:
+        return sol.sensitivities.bc_a;
+    default:
+        return sol.sensitivities.bc_b;
+    }
+}
+
+// shape function weights of the element holding x, over the nodes
+// first, first+1, ..., first+Order of the solution vectors
+template<int Order>
+static void shapeWeights( const VectorXd &X, double x, int &first, double *w )
+{
+    int ne = (X.size() - 1)/Order;
+    int lo = 0;
+    int hi = ne;
+    while (hi - lo > 1)
+    {
+        int mid = (lo + hi)/2;
+        if (X(mid*Order) <= x)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    double x0 = X(lo*Order);
+    double h = X((lo + 1)*Order) - x0;
+    double xi = std::clamp((x - x0)/h, 0.0, 1.0);
+    first = lo*Order;
+    for (int j = 0; j <= Order; j++)
+    {
+        w[j] = LagrangeElement<Order>::shape(j, xi);
+    }
+}
+
+// two sided 95% quantile of Student's t; tabulated up to 30 degrees
+// of freedom, then the Cornish-Fisher expansion about the normal one
+static double studentT95( int dof )
+{
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if (dof <= 30)
+    {
+        return table[dof - 1];
+    }
+    double z = 1.959963984540054;
+    double z3 = z*z*z;
+    double z5 = z3*z*z;
+    return z + (z3 + z)/(4.0*dof) + (5.0*z5 + 16.0*z3 + 3.0*z)/(96.0*dof*dof);
+}
+
+Calibration::Calibration( const FiniteElementModel &base )
+    : baseModel(base)
+{
+    parameters.push_back(CalibrationParameter::K);
+    threads = 0;
+    tolerance = 1.0e-8;
+    maxIterations = 50;
+    exact = true;
+    solveCount = 0;
+}
+
+void Calibration::set_measurements( const std::vector<Measurement> &points )
+{
+    measurements = points;
+}
+
+void Calibration::set_parameters( const std::vector<CalibrationParameter> &which )
+{
+    parameters = which;
+}
+
+void Calibration::set_threads( int new_threads )
+{
+    threads = new_threads;
+}
+
+void Calibration::set_tolerance( double new_tol )
+{
+    tolerance = new_tol;
+}
+
+void Calibration::set_max_iterations( int new_max )
+{
+    maxIterations = new_max;
+}
+
+const char *Calibration::parameterName( CalibrationParameter which )
+{
+    switch (which)
+    {
+    case CalibrationParameter::K:
+        return "k";
+    case CalibrationParameter::Q:
+        return "q";
+    case CalibrationParameter::BC_A:
+        return "bc_a";
+    default:
+        return "bc_b";
+    }
+}
+
+bool Calibration::parseParameters( const std::string &list, std::vector<CalibrationParameter> &which,
+                                   std::string &error )
+{
+    static const CalibrationParameter all[] = { CalibrationParameter::K, CalibrationParameter::Q,
+                                                CalibrationParameter::BC_A, CalibrationParameter::BC_B };
+    which.clear();
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = std::min(list.find(',', start), list.size());
+        std::string name = list.substr(start, end - start);
+        bool found = false;
+        for (CalibrationParameter p : all)
+        {
+            if (name == parameterName(p))
+            {
+                which.push_back(p);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            error = "unknown parameter '" + name + "', expected k, q, bc_a or bc_b";
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+bool Calibration::readMeasurements( const std::string &fileName, std::vector<Measurement> &points,
+                                    std::string &error )
+{
+    std::ifstream in(fileName);
+    if (!in)
+    {
+        error = "cannot open measurement file " + fileName;
+        return false;
+    }
+    points.clear();
+    std::string line;
+    long lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::replace_if(line.begin(), line.end(), [](char c) { return c == ',' || c == ';'; }, ' ');
+        const char *text = line.c_str();
+        char *end;
+        Measurement m;
+        m.x = std::strtod(text, &end);
+        if (end == text)
+        {
+            continue; // blank, comment or header
+        }
+        text = end;
+        m.T = std::strtod(text, &end);
+        if (end == text || !std::isfinite(m.x) || !std::isfinite(m.T))
+        {
+            error = "line " + std::to_string(lineNumber) + " of " + fileName + ": expected x,T";
+            return false;
+        }
+        points.push_back(m);
+    }
+    if (points.empty())
+    {
+        error = "no measurements in " + fileName;
+        return false;
+    }
+    return true;
+}
+
+bool Calibration::check( std::string &error )
+{
+    bool hasK = false;
+    bool hasQ = false;
+    for (size_t i = 0; i < parameters.size(); i++)
+    {
+        hasK = hasK || parameters[i] == CalibrationParameter::K;
+        hasQ = hasQ || parameters[i] == CalibrationParameter::Q;
+        if (std::count(parameters.begin(), parameters.end(), parameters[i]) > 1)
+        {
+            error = std::string("parameter ") + parameterName(parameters[i]) + " given twice";
+            return false;
+        }
+    }
+    if (parameters.empty())
+    {
+        error = "no parameters to fit";
+        return false;
+    }
+    if (measurements.size() < parameters.size())
+    {
+        error = "need at least as many measurements as fitted parameters";
+        return false;
+    }
+    if (hasK && baseModel.has_conductivity_curve())
+    {
+        error = "k is replaced by the conductivity curve and cannot be fitted";
+        return false;
+    }
+    if ((hasK || hasQ) && !baseModel.get_layers().empty())
+    {
+        error = "k and q are replaced by the layers and cannot be fitted";
+        return false;
+    }
+    if (hasK && hasQ)
+    {
+        error = "k and q cannot both be fitted, with fixed boundary temperatures "
+                "the profile only depends on q/k; fix one of them";
+        return false;
+    }
+    double a = std::min(baseModel.get_a(), baseModel.get_b());
+    double b = std::max(baseModel.get_a(), baseModel.get_b());
+    for (size_t i = 0; i < measurements.size(); i++)
+    {
+        if (!(measurements[i].x >= a && measurements[i].x <= b))
+        {
+            error = "measurement at x=" + std::to_string(measurements[i].x) + " is outside the rod";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Calibration::evaluate( FiniteElementModel &model, const VectorXd &p, VectorXd &r,
+                            MatrixXd *J, FiniteElementSolution *keep )
+{
+    for (size_t c = 0; c < parameters.size(); c++)
+    {
+        setParameter(model, parameters[c], p(c));
+    }
+    FiniteElementSolution sol = model.findNodalSolution();
+    solveCount++;
+    if (sol.cancelled || !sol.stats.converged)
+    {
+        return false;
+    }
+    model.convertToDisplayUnits(sol);
+
+    // residuals, and with J the sensitivities, at the measurement
+    // positions through the shape functions of the solution's elements
+    int order = (int)model.get_element();
+    int m = measurements.size();
+    r.resize(m);
+    for (int i = 0; i < m; i++)
+    {
+        int first;
+        double w[4];
+        if (order == 3)
+        {
+            shapeWeights<3>(sol.nodalXVals, measurements[i].x, first, w);
+        }
+        else if (order == 2)
+        {
+            shapeWeights<2>(sol.nodalXVals, measurements[i].x, first, w);
+        }
+        else
+        {
+            shapeWeights<1>(sol.nodalXVals, measurements[i].x, first, w);
+        }
+        r(i) = -measurements[i].T;
+        for (int j = 0; j <= order; j++)
+        {
+            r(i) += w[j]*sol.nodalSolution(first + j);
+        }
+        if (J != nullptr)
+        {
+            for (size_t c = 0; c < parameters.size(); c++)
+            {
+                const VectorXd &s = sensitivity(sol, parameters[c]);
+                double value = 0.0;
+                for (int j = 0; j <= order; j++)
+                {
+                    value += w[j]*s(first + j);
+                }
+                (*J)(i, c) = value;
+            }
+        }
+    }
+    if (keep != nullptr)
+    {
+        *keep = std::move(sol);
+    }
+    return true;
+}
+
+bool Calibration::differenceJacobian( ThreadPool &pool, const VectorXd &p, const VectorXd &r, MatrixXd &J )
+{
+    PROFILE_SCOPE("calibration.jacobian");
+    // one forward difference per column, the solves are independent
+    // and each worker has its own model
+    int np = parameters.size();
+    std::vector<FiniteElementModel> models( pool.size(), baseModel );
+    std::vector<char> solved(np, 0);
+    pool.parallelFor(np, [&](size_t c, int worker)
+    {
+        VectorXd shifted = p;
+        double h = 1.0e-7*std::max(std::abs(p(c)), 1.0);
+        shifted(c) += h;
+        VectorXd rc;
+        if (evaluate(models[worker], shifted, rc, nullptr, nullptr))
+        {
+            J.col(c) = (rc - r)/h;
+            solved[c] = 1;
+        }
+    });
+    return std::count(solved.begin(), solved.end(), 0) == 0;
+}
+
+CalibrationResult Calibration::run()
+{
+    PROFILE_SCOPE("calibration.run");
+    auto start = std::chrono::steady_clock::now();
+    CalibrationResult res;
+    res.ok = false;
+    res.converged = false;
+    res.rms = 0.0;
+    res.iterations = 0;
+    res.solves = 0;
+    res.seconds = 0.0;
+    solveCount = 0;
+    if (!check(res.error))
+    {
+        return res;
+    }
+
+    // the sensitivities give the Jacobian unless k depends on T, they
+    // only cost substitutions against the factorization of the solve
+    exact = !baseModel.has_conductivity_curve();
+    res.exactGradients = exact;
+    FiniteElementModel model = baseModel;
+    model.set_sensitivities(exact);
+    std::unique_ptr<ThreadPool> pool;
+    if (!exact)
+    {
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+
+    int np = parameters.size();
+    int m = measurements.size();
+    VectorXd p(np);
+    for (int c = 0; c < np; c++)
+    {
+        p(c) = getParameter(model, parameters[c]);
+    }
+    VectorXd r;
+    MatrixXd J(m, np);
+    FiniteElementSolution best;
+    if (!evaluate(model, p, r, exact ? &J : nullptr, &best)
+        || (!exact && !differenceJacobian(*pool, p, r, J)))
+    {
+        res.error = "the model does not solve at the starting values";
+        return res;
+    }
+    double cost = 0.5*r.squaredNorm();
+
+    // Levenberg-Marquardt with Marquardt's diagonal scaling, so k, q
+    // and temperatures can be mixed, and Nielsen's damping update
+    double lambda = 1.0e-3;
+    double nu = 2.0;
+    VectorXd trial, rTrial, step;
+    MatrixXd JTrial(m, np);
+    FiniteElementSolution trialSolution;
+    bool stalled = false;
+    while (!res.converged && !stalled && res.iterations < maxIterations && cost > 0.0)
+    {
+        MatrixXd A = J.transpose()*J;
+        VectorXd g = J.transpose()*r;
+        VectorXd d = A.diagonal();
+        for (int c = 0; c < np; c++)
+        {
+            if (!(d(c) > 0.0))
+            {
+                res.error = std::string("no measurement depends on ") + parameterName(parameters[c]);
+                return res;
+            }
+        }
+
+        MatrixXd M = A;
+        M.diagonal() += lambda*d;
+        step = M.ldlt().solve(-g);
+        bool small = true;
+        for (int c = 0; c < np; c++)
+        {
+            small = small && std::abs(step(c)) <= tolerance*(std::abs(p(c)) + tolerance);
+        }
+        if (small)
+        {
+            res.converged = true; // nothing left to gain at this point
+            break;
+        }
+
+        trial = p + step;
+        bool valid = true;
+        for (int c = 0; c < np; c++)
+        {
+            valid = valid && (parameters[c] != CalibrationParameter::K || trial(c) > 0.0);
+        }
+        valid = valid && evaluate(model, trial, rTrial, exact ? &JTrial : nullptr, &trialSolution);
+        double trialCost = valid ? 0.5*rTrial.squaredNorm() : cost;
+        if (!valid || trialCost >= cost)
+        {
+            // rejected, retry closer to gradient descent
+            lambda *= nu;
+            nu *= 2.0;
+            stalled = lambda > 1.0e16;
+            continue;
+        }
+
+        double predicted = 0.5*step.dot(lambda*d.cwiseProduct(step) - g);
+        double rho = (cost - trialCost)/predicted;
+        lambda *= std::max(1.0/3.0, 1.0 - std::pow(2.0*rho - 1.0, 3));
+        nu = 2.0;
+        res.converged = (cost - trialCost) <= tolerance*cost;
+        res.iterations++;
+        p.swap(trial);
+        r.swap(rTrial);
+        cost = trialCost;
+        std::swap(best, trialSolution);
+        if (exact)
+        {
+            J.swap(JTrial);
+        }
+        else if (!differenceJacobian(*pool, p, r, J))
+        {
+            res.error = "the model does not solve near the fitted values";
+            return res;
+        }
+    }
+    res.converged = res.converged || cost == 0.0;
+
+    // covariance from the linearization at the fit, scaled by the
+    // residual variance since the reading errors are not known
+    int dof = m - np;
+    MatrixXd covariance = (J.transpose()*J).ldlt().solve( MatrixXd::Identity(np, np) );
+    double variance = (dof > 0) ? 2.0*cost/dof : std::numeric_limits<double>::quiet_NaN();
+    double t = (dof > 0) ? studentT95(dof) : std::numeric_limits<double>::quiet_NaN();
+    for (int c = 0; c < np; c++)
+    {
+        CalibratedValue v;
+        v.parameter = parameters[c];
+        v.value = p(c);
+        v.standardError = std::sqrt(variance*covariance(c, c));
+        v.lower = v.value - t*v.standardError;
+        v.upper = v.value + t*v.standardError;
+        res.values.push_back(v);
+    }
+    res.ok = true;
+    res.rms = std::sqrt(2.0*cost/m);
+    res.solves = solveCount;
+    res.solution = std::move(best);
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return res;
+}
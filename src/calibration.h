@@ -0,0 +1,122 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "finiteelementmodel.h"
+class ThreadPool;
+
+// inputs a calibration can fit
+enum class CalibrationParameter
+{
+    K, Q, BC_A, BC_B
+};
+
+// one thermocouple reading, in the base model's unit system
+typedef struct
+{
+    double x;
+    double T;
+}
+Measurement;
+
+// one fitted input in the base model's unit system; the interval is
+// the 95% one from the linearized covariance at the fit, NaN if there
+// are no more measurements than fitted inputs
+typedef struct
+{
+    CalibrationParameter parameter;
+    double value;
+    double standardError;
+    double lower;
+    double upper;
+}
+CalibratedValue;
+
+typedef struct
+{
+    bool ok; // false with the reason in error, nothing else is set
+    std::string error;
+    bool converged; // step or misfit change below the tolerance
+    bool exactGradients; // from the solution sensitivities, else differences
+    std::vector<CalibratedValue> values;
+    double rms; // residual at the fit, display temperature units
+    int iterations;
+    int solves; // forward solves, including Jacobian columns
+    double seconds;
+    FiniteElementSolution solution; // at the fit, display units
+}
+CalibrationResult;
+
+// fits some of k, q and the boundary values of the base model to
+// measured temperatures with Levenberg-Marquardt. The model is
+// evaluated at the measurement positions through its element shape
+// functions. The Jacobian comes from FiniteElementSolution
+// sensitivities where the model has them, so a step costs one solve
+// plus substitutions; with a k(T) curve the columns are forward
+// differences solved in parallel. The base model's values are the
+// starting point. With fixed boundary temperatures and a single
+// material the profile only depends on q/k, so k and q cannot both be
+// fitted; one of them has to be known.
+class Calibration
+{
+
+public:
+    Calibration( const FiniteElementModel &base );
+
+    void set_measurements( const std::vector<Measurement> &points );
+    void set_parameters( const std::vector<CalibrationParameter> &which ); // k by default
+    void set_threads( int new_threads ); // 0 = one per core, differences only
+    void set_tolerance( double new_tol ); // relative step size at convergence
+    void set_max_iterations( int new_max );
+
+    CalibrationResult run();
+
+    static const char *parameterName( CalibrationParameter which );
+    // comma separated names, e.g. "k,bc_a"
+    static bool parseParameters( const std::string &list, std::vector<CalibrationParameter> &which,
+                                 std::string &error );
+    // x,T per line, separated by commas or blanks, '#' comments and
+    // lines that do not start with a number (a header) are skipped
+    static bool readMeasurements( const std::string &fileName, std::vector<Measurement> &points,
+                                  std::string &error );
+
+private:
+    bool check( std::string &error );
+    bool evaluate( FiniteElementModel &model, const VectorXd &p, VectorXd &r,
+                   Eigen::MatrixXd *J, FiniteElementSolution *keep );
+    bool differenceJacobian( ThreadPool &pool, const VectorXd &p, const VectorXd &r, Eigen::MatrixXd &J );
+
+    FiniteElementModel baseModel;
+    std::vector<Measurement> measurements;
+    std::vector<CalibrationParameter> parameters;
+    int threads;
+    double tolerance;
+    int maxIterations;
+    bool exact;
+    std::atomic<int> solveCount;
+};
+
+#endif // CALIBRATION_H
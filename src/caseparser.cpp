@@ -0,0 +1,545 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "caseparser.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+// colon separated finite numbers, at least one
+static bool parseList( const std::string &value, std::vector<double> &list )
+{
+    list.clear();
+    const char *field = value.c_str();
+    while (true)
+    {
+        char *rest = nullptr;
+        double num = std::strtod(field, &rest);
+        if (rest == field || (*rest != ':' && *rest != '\0') || !std::isfinite(num))
+        {
+            return false;
+        }
+        list.push_back(num);
+        if (*rest == '\0')
+        {
+            return true;
+        }
+        field = rest + 1;
+    }
+}
+
+static bool parseCoord( const std::string &value, CoordType &coord )
+{
+    if (value == "cartesian")
+    {
+        coord = CoordType::CARTESIAN;
+    }
+    else if (value == "cylindrical")
+    {
+        coord = CoordType::CYLINDRICAL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool parseSolver( const std::string &value, SolverType &solver )
+{
+    if (value == "banded")
+    {
+        solver = SolverType::BANDED;
+    }
+    else if (value == "ldlt")
+    {
+        solver = SolverType::SPARSE_LDLT;
+    }
+    else if (value == "cg")
+    {
+        solver = SolverType::CG_JACOBI;
+    }
+    else if (value == "cg-ichol")
+    {
+        solver = SolverType::CG_ICHOL;
+    }
+    else if (value == "bicgstab")
+    {
+        solver = SolverType::BICGSTAB;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// the value of the units key, wherever it is in the case
+static bool findUnits( const std::vector< std::pair<std::string, std::string> > &pairs,
+                       UnitSystem &units, bool &given, std::string &error )
+{
+    given = false;
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        if (pairs[i].first != "units")
+        {
+            continue;
+        }
+        if (pairs[i].second == "english")
+        {
+            units = UnitSystem::ENGLISH;
+        }
+        else if (pairs[i].second == "si")
+        {
+            units = UnitSystem::SI;
+        }
+        else
+        {
+            error = "unknown unit system '" + pairs[i].second + "'";
+            return false;
+        }
+        given = true;
+    }
+    return true;
+}
+
+bool applyCaseKey( FiniteElementModel &model, const std::string &key,
+                   const std::string &value )
+{
+    char *end = nullptr;
+    double num = std::strtod(value.c_str(), &end);
+    // inf and nan would only come back as a solution full of them
+    bool isNumber = (end != value.c_str() && *end == '\0' && std::isfinite(num));
+
+    if (key == "coord")
+    {
+        CoordType coord;
+        if (!parseCoord(value, coord))
+        {
+            return false;
+        }
+        model.set_coord(coord);
+    }
+    else if (key == "element")
+    {
+        if (value == "linear")
+        {
+            model.set_element( ElementType::LINEAR );
+        }
+        else if (value == "quadratic")
+        {
+            model.set_element( ElementType::QUADRATIC );
+        }
+        else if (value == "cubic")
+        {
+            model.set_element( ElementType::CUBIC );
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (key == "solver")
+    {
+        SolverType solver;
+        if (!parseSolver(value, solver))
+        {
+            return false;
+        }
+        model.set_solver(solver);
+    }
+    else if (key == "layer")
+    {
+        // end:k:q, one key per layer, in any order
+        MaterialLayer layer;
+        char *rest = nullptr;
+        layer.end = std::strtod(value.c_str(), &rest);
+        if (rest == value.c_str() || *rest != ':' || !std::isfinite(layer.end))
+        {
+            return false;
+        }
+        const char *field = rest + 1;
+        layer.k = std::strtod(field, &rest);
+        if (rest == field || *rest != ':' || !(layer.k > 0.0) || !std::isfinite(layer.k))
+        {
+            return false;
+        }
+        field = rest + 1;
+        layer.q = std::strtod(field, &rest);
+        if (rest == field || *rest != '\0' || !std::isfinite(layer.q))
+        {
+            return false;
+        }
+        std::vector<MaterialLayer> layers = model.get_layers();
+        layers.push_back(layer);
+        model.set_layers(layers);
+    }
+    else if (key == "k_table")
+    {
+        // T:k pairs, any order
+        std::vector<double> list;
+        if (!parseList(value, list) || list.size() % 2 != 0)
+        {
+            return false;
+        }
+        std::vector<double> T, k;
+        for (size_t i = 0; i < list.size(); i += 2)
+        {
+            if (!(list[i+1] > 0.0))
+            {
+                return false;
+            }
+            T.push_back(list[i]);
+            k.push_back(list[i+1]);
+        }
+        model.set_conductivity_table(T, k);
+    }
+    else if (key == "k_poly")
+    {
+        std::vector<double> coefficients;
+        // k(T) must at least be positive at T = 0, the iteration
+        // stops wherever it is not
+        if (!parseList(value, coefficients) || !(coefficients[0] > 0.0))
+        {
+            return false;
+        }
+        model.set_conductivity_polynomial(coefficients);
+    }
+    else if (key == "nonlinear")
+    {
+        if (value == "newton")
+        {
+            model.set_nonlinear_method( NonlinearMethod::NEWTON );
+        }
+        else if (value == "picard")
+        {
+            model.set_nonlinear_method( NonlinearMethod::PICARD );
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (!isNumber)
+    {
+        return false;
+    }
+    else if (key == "a")
+    {
+        model.set_a(num);
+    }
+    else if (key == "b")
+    {
+        model.set_b(num);
+    }
+    else if (key == "bc_a")
+    {
+        model.set_bc_a(num);
+    }
+    else if (key == "bc_b")
+    {
+        model.set_bc_b(num);
+    }
+    else if (key == "k")
+    {
+        if (!(num > 0.0))
+        {
+            return false;
+        }
+        model.set_k(num);
+    }
+    else if (key == "q")
+    {
+        model.set_q(num);
+    }
+    else if (key == "n")
+    {
+        if (!(num >= 2 && num <= maxCaseNodes) || num != std::floor(num))
+        {
+            return false;
+        }
+        model.set_n( (int)num );
+    }
+    else if (key == "rho")
+    {
+        if (!(num > 0.0))
+        {
+            return false;
+        }
+        model.set_rho(num);
+    }
+    else if (key == "cp")
+    {
+        if (!(num > 0.0))
+        {
+            return false;
+        }
+        model.set_cp(num);
+    }
+    else if (key == "t0")
+    {
+        model.set_t0(num);
+    }
+    else if (key == "adaptive")
+    {
+        if (num < 0)
+        {
+            return false;
+        }
+        model.set_adaptive_tolerance(num);
+    }
+    else if (key == "max_passes")
+    {
+        if (!(num >= 0 && num <= 1000) || num != std::floor(num))
+        {
+            return false;
+        }
+        model.set_max_refinements( (int)num );
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool applyCasePairs( const std::vector< std::pair<std::string, std::string> > &pairs,
+                    FiniteElementModel &model, std::string &error )
+{
+    UnitSystem units;
+    bool given;
+    if (!findUnits(pairs, units, given, error))
+    {
+        return false;
+    }
+    if (given)
+    {
+        model.set_unit_sys(units);
+    }
+
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        if (pairs[i].first != "units" && !applyCaseKey(model, pairs[i].first, pairs[i].second))
+        {
+            error = "bad value for '" + pairs[i].first + "'";
+            return false;
+        }
+    }
+    if (model.get_a() == model.get_b())
+    {
+        error = "a and b must differ";
+        return false;
+    }
+    return true;
+}
+
+bool applyCaseKey( FiniteElementModel2D &model, const std::string &key,
+                   const std::string &value )
+{
+    char *end = nullptr;
+    double num = std::strtod(value.c_str(), &end);
+    bool isNumber = (end != value.c_str() && *end == '\0' && std::isfinite(num));
+
+    static const std::pair<const char *, GridEdge> edges[] = {
+        { "left", GridEdge::LEFT }, { "right", GridEdge::RIGHT },
+        { "bottom", GridEdge::BOTTOM }, { "top", GridEdge::TOP } };
+    for (const auto &edge : edges)
+    {
+        if (key != edge.first)
+        {
+            continue;
+        }
+        if (value == "insulated")
+        {
+            model.set_edge_insulated(edge.second);
+        }
+        else if (isNumber)
+        {
+            model.set_edge_value(edge.second, num);
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    if (key == "coord")
+    {
+        CoordType coord;
+        if (!parseCoord(value, coord))
+        {
+            return false;
+        }
+        model.set_coord(coord);
+    }
+    else if (key == "solver")
+    {
+        SolverType solver;
+        if (!parseSolver(value, solver))
+        {
+            return false;
+        }
+        model.set_solver(solver);
+    }
+    else if (!isNumber)
+    {
+        return false;
+    }
+    else if (key == "a")
+    {
+        model.set_a(num);
+    }
+    else if (key == "b")
+    {
+        model.set_b(num);
+    }
+    else if (key == "c")
+    {
+        model.set_c(num);
+    }
+    else if (key == "d")
+    {
+        model.set_d(num);
+    }
+    else if (key == "k")
+    {
+        if (!(num > 0.0))
+        {
+            return false;
+        }
+        model.set_k(num);
+    }
+    else if (key == "q")
+    {
+        model.set_q(num);
+    }
+    else if (key == "nx")
+    {
+        if (!(num >= 2 && num <= maxCaseNodes) || num != std::floor(num))
+        {
+            return false;
+        }
+        model.set_nx( (int)num );
+    }
+    else if (key == "ny")
+    {
+        if (!(num >= 2 && num <= maxCaseNodes) || num != std::floor(num))
+        {
+            return false;
+        }
+        model.set_ny( (int)num );
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool applyCasePairs( const std::vector< std::pair<std::string, std::string> > &pairs,
+                    FiniteElementModel2D &model, std::string &error )
+{
+    UnitSystem units;
+    bool given;
+    if (!findUnits(pairs, units, given, error))
+    {
+        return false;
+    }
+    if (given)
+    {
+        model.set_unit_sys(units);
+    }
+
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        if (pairs[i].first != "units" && !applyCaseKey(model, pairs[i].first, pairs[i].second))
+        {
+            error = "bad value for '" + pairs[i].first + "'";
+            return false;
+        }
+    }
+    if (model.get_a() == model.get_b() || model.get_c() == model.get_d())
+    {
+        error = "a and b, and c and d, must differ";
+        return false;
+    }
+    if ((double)model.get_nx()*model.get_ny() > maxCaseNodes)
+    {
+        error = "more than " + std::to_string(maxCaseNodes) + " grid nodes";
+        return false;
+    }
+    if (!model.get_edge_fixed(GridEdge::LEFT) && !model.get_edge_fixed(GridEdge::RIGHT)
+        && !model.get_edge_fixed(GridEdge::BOTTOM) && !model.get_edge_fixed(GridEdge::TOP))
+    {
+        error = "no edge is held at a temperature";
+        return false;
+    }
+    return true;
+}
+
+bool splitCase( const std::string &line,
+                std::vector< std::pair<std::string, std::string> > &pairs, std::string &error )
+{
+    std::string text = line;
+    size_t comment = text.find('#');
+    if (comment != std::string::npos)
+    {
+        text.erase(comment);
+    }
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] == ',' || text[i] == ';' || text[i] == '\t' || text[i] == '\r' || text[i] == '\n')
+        {
+            text[i] = ' ';
+        }
+    }
+
+    std::istringstream tokens(text);
+    std::string token;
+    pairs.clear();
+    while (tokens >> token)
+    {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos)
+        {
+            error = "malformed token '" + token + "'";
+            return false;
+        }
+        pairs.push_back( std::make_pair(token.substr(0, eq), token.substr(eq+1)) );
+    }
+    return true;
+}
+
+bool parseCase( const std::string &line, FiniteElementModel &model, std::string &error )
+{
+    PROFILE_SCOPE("case.parse");
+    std::vector< std::pair<std::string, std::string> > pairs;
+    return splitCase(line, pairs, error) && applyCasePairs(pairs, model, error);
+}
+
+bool parseCase( const std::string &line, FiniteElementModel2D &model, std::string &error )
+{
+    PROFILE_SCOPE("case.parse");
+    std::vector< std::pair<std::string, std::string> > pairs;
+    return splitCase(line, pairs, error) && applyCasePairs(pairs, model, error);
+}
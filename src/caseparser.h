@@ -0,0 +1,71 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef CASEPARSER_H
+#define CASEPARSER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "finiteelementmodel.h"
+#include "finiteelementmodel2d.h"
+
+// the key=value case language shared by the batch tool and the solve
+// server, e.g.
+//   a=0 b=2 bc_a=700 bc_b=300 k=2 q=1000 n=101 coord=cylindrical units=si
+// layered walls repeat layer=end:k:q, which replaces k and q
+// k(T) is given as k_table=T:k:T:k:... or k_poly=c0:c1:..., solved with
+// nonlinear=newton (default) or picard
+// rho, cp and t0 only matter to transient runs
+// keys not given keep the model defaults
+
+// largest n a case may ask for; far beyond any useful resolution of a
+// 1D problem, and small enough that a typo cannot exhaust the memory
+const int maxCaseNodes = 10000000;
+
+// apply one key=value pair to the model, returns false if not understood;
+// values are read in the model's current unit system
+bool applyCaseKey( FiniteElementModel &model, const std::string &key,
+                   const std::string &value );
+
+// apply a whole case; a units key is applied first, wherever it is, so
+// the other values are read in those units
+bool applyCasePairs( const std::vector< std::pair<std::string, std::string> > &pairs,
+                    FiniteElementModel &model, std::string &error );
+
+// split a case line into whitespace, comma or semicolon separated
+// key=value tokens; '#' starts a comment
+bool splitCase( const std::string &line,
+                std::vector< std::pair<std::string, std::string> > &pairs, std::string &error );
+
+// splitCase and applyCasePairs in one
+bool parseCase( const std::string &line, FiniteElementModel &model, std::string &error );
+
+// the same for a 2D grid: a, b, c, d, k, q, nx, ny, coord, solver,
+// units, and left, right, bottom and top set to a temperature or to
+// insulated; nx*ny is held to maxCaseNodes and one edge must be fixed
+bool applyCaseKey( FiniteElementModel2D &model, const std::string &key,
+                   const std::string &value );
+bool applyCasePairs( const std::vector< std::pair<std::string, std::string> > &pairs,
+                    FiniteElementModel2D &model, std::string &error );
+bool parseCase( const std::string &line, FiniteElementModel2D &model, std::string &error );
+
+#endif // CASEPARSER_H
@@ -0,0 +1,109 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "conductivitycurve.h"
+
+#include <algorithm>
+#include <numeric>
+
+ConductivityCurve::ConductivityCurve()
+{
+}
+
+void ConductivityCurve::set_table( const std::vector<double> &T, const std::vector<double> &k )
+{
+    clear();
+    size_t n = std::min(T.size(), k.size());
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&T](size_t x, size_t y) { return T[x] < T[y]; });
+    for (size_t i = 0; i < n; i++)
+    {
+        tableT.push_back( T[order[i]] );
+        tableK.push_back( k[order[i]] );
+    }
+}
+
+void ConductivityCurve::set_polynomial( const std::vector<double> &coefficients )
+{
+    clear();
+    poly = coefficients;
+}
+
+void ConductivityCurve::clear()
+{
+    tableT.clear();
+    tableK.clear();
+    poly.clear();
+}
+
+bool ConductivityCurve::empty() const
+{
+    return tableT.empty() && poly.empty();
+}
+
+const std::vector<double> &ConductivityCurve::get_table_T() const
+{
+    return tableT;
+}
+
+const std::vector<double> &ConductivityCurve::get_table_k() const
+{
+    return tableK;
+}
+
+const std::vector<double> &ConductivityCurve::get_polynomial() const
+{
+    return poly;
+}
+
+void ConductivityCurve::evaluate( double T, double &k, double &dkdT ) const
+{
+    if (!poly.empty())
+    {
+        // Horner for the value and the derivative together
+        k = 0.0;
+        dkdT = 0.0;
+        for (size_t i = poly.size(); i-- > 0; )
+        {
+            dkdT = dkdT*T + k;
+            k = k*T + poly[i];
+        }
+        return;
+    }
+
+    size_t n = tableT.size();
+    if (n == 1 || T <= tableT[0])
+    {
+        k = tableK[0];
+        dkdT = 0.0;
+        return;
+    }
+    if (T >= tableT[n-1])
+    {
+        k = tableK[n-1];
+        dkdT = 0.0;
+        return;
+    }
+    size_t i = std::upper_bound(tableT.begin(), tableT.end(), T) - tableT.begin();
+    double span = tableT[i] - tableT[i-1];
+    dkdT = (span > 0.0) ? (tableK[i] - tableK[i-1])/span : 0.0;
+    k = tableK[i-1] + dkdT*(T - tableT[i-1]);
+}
@@ -0,0 +1,53 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef CONDUCTIVITYCURVE_H
+#define CONDUCTIVITYCURVE_H
+
+#include <vector>
+
+// temperature dependent conductivity k(T) in SI, either a table of
+// points joined by straight lines (held constant past either end) or
+// a polynomial k = c0 + c1*T + c2*T^2 + ...; an empty curve means the
+// model's constant k applies
+class ConductivityCurve
+{
+
+public:
+    ConductivityCurve();
+    // points in any order, sorted by temperature here
+    void set_table( const std::vector<double> &T, const std::vector<double> &k );
+    void set_polynomial( const std::vector<double> &coefficients );
+    void clear();
+    bool empty() const;
+    const std::vector<double> &get_table_T() const;
+    const std::vector<double> &get_table_k() const;
+    const std::vector<double> &get_polynomial() const;
+
+    // k and dk/dT at temperature T
+    void evaluate( double T, double &k, double &dkdT ) const;
+
+private:
+    std::vector<double> tableT;
+    std::vector<double> tableK;
+    std::vector<double> poly; // c0 first
+};
+
+#endif // CONDUCTIVITYCURVE_H
@@ -0,0 +1,113 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "convergencestudy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+ConvergenceStudy::ConvergenceStudy( const FiniteElementModel &base )
+    : baseModel(base)
+{
+    nValues.push_back( baseModel.get_n() );
+}
+
+void ConvergenceStudy::set_sizes( const std::vector<int> &sizes )
+{
+    if (!sizes.empty())
+    {
+        nValues = sizes;
+    }
+}
+
+void ConvergenceStudy::set_range( int first, int last )
+{
+    std::vector<int> sizes;
+    for (int n = std::max(first, 2); n <= last; n = 2*n - 1)
+    {
+        sizes.push_back(n);
+    }
+    set_sizes(sizes);
+}
+
+static double observedOrder( double previousError, double error, double previousH, double h )
+{
+    if (previousError <= 0.0 || error <= 0.0)
+    {
+        return 0.0;
+    }
+    return std::log(previousError/error)/std::log(previousH/h);
+}
+
+std::vector<ConvergenceResult> ConvergenceStudy::run()
+{
+    std::vector<ConvergenceResult> results;
+    FiniteElementModel model = baseModel;
+    double length = model.get_b() - model.get_a();
+    double previousH = 0.0;
+
+    for (size_t i = 0; i < nValues.size(); i++)
+    {
+        model.set_n( nValues[i] );
+        auto start = std::chrono::steady_clock::now();
+        FiniteElementSolution sol = model.findNodalSolution();
+        auto stop = std::chrono::steady_clock::now();
+        if (sol.cancelled)
+        {
+            break;
+        }
+
+        ConvergenceResult r;
+        r.n = nValues[i];
+        r.dofs = (int)sol.nodalSolution.size();
+        r.error = model.solutionError(sol);
+        r.seconds = std::chrono::duration<double>(stop - start).count();
+        // adaptive meshes are not uniform, use the mean element length
+        double h = length/(sol.nodalXVals.size() - 1);
+        if (results.empty())
+        {
+            r.orderL2 = r.orderLinf = r.orderH1 = 0.0;
+        }
+        else
+        {
+            const SolutionError &e = results.back().error;
+            r.orderL2 = observedOrder(e.l2, r.error.l2, previousH, h);
+            r.orderLinf = observedOrder(e.linf, r.error.linf, previousH, h);
+            r.orderH1 = observedOrder(e.h1, r.error.h1, previousH, h);
+        }
+        previousH = h;
+        results.push_back(r);
+    }
+    return results;
+}
+
+int ConvergenceStudy::cheapest( const std::vector<ConvergenceResult> &results, double tolerance )
+{
+    int best = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (results[i].error.linf <= tolerance && (best == 0 || results[i].n < best))
+        {
+            best = results[i].n;
+        }
+    }
+    return best;
+}
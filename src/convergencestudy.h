@@ -0,0 +1,66 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef CONVERGENCESTUDY_H
+#define CONVERGENCESTUDY_H
+
+#include <vector>
+
+#include "finiteelementmodel.h"
+
+// errors against the closed form for one mesh size, in SI units; the
+// observed orders compare with the previous entry of the study and are
+// zero for the first one
+typedef struct
+{
+    int n;
+    int dofs;
+    SolutionError error;
+    double orderL2;
+    double orderLinf;
+    double orderH1;
+    double seconds; // wall time of the solve only
+}
+ConvergenceResult;
+
+// solves the base model for a sequence of mesh sizes and measures the
+// discretisation error against the analytical solution, for picking the
+// cheapest n that meets an accuracy spec
+class ConvergenceStudy
+{
+
+public:
+    ConvergenceStudy( const FiniteElementModel &base );
+
+    void set_sizes( const std::vector<int> &sizes );
+    // first, 2*first-1, ... up to last; halving h keeps the nodes nested
+    void set_range( int first, int last );
+
+    std::vector<ConvergenceResult> run();
+
+    // smallest n whose L-infinity error is within tolerance (SI), or 0
+    static int cheapest( const std::vector<ConvergenceResult> &results, double tolerance );
+
+private:
+    FiniteElementModel baseModel;
+    std::vector<int> nValues;
+};
+
+#endif // CONVERGENCESTUDY_H
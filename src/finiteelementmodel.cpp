@@ -19,17 +19,88 @@
   */
 
 #include "finiteelementmodel.h"
+#include "tridiagonalsolver.h"
+#include "sparseassembler.h"
+#include "linearsolver.h"
+#include "nonlinearsolver.h"
+#include "profiler.h"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
 #include <eigen3/Eigen/Dense>
-#include <eigen3/Eigen/LU>
 using Eigen::MatrixXd;
 using Eigen::Matrix2d;
 using Eigen::VectorXd;
 using Eigen::Vector2d;
 
-#include <KF6/KUnitConversion/KUnitConversion/Converter>
-#include <KF6/KUnitConversion/KUnitConversion/Value>
-using KUnitConversion::Value;
-using KUnitConversion::Unit;
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+// one adaptive step on the element lengths: bisect every element whose
+// estimate is over target, and merge a pair of neighbours when the
+// merged element is predicted to stay well under it. For a smooth
+// solution eta_e goes like h^(order+1/2), so merging two elements
+// multiplies their combined estimate by about 2^order. Neighbours of
+// different material are never merged, so interfaces stay on vertices.
+static VectorXd adaptMesh( const VectorXd &mesh, const VectorXd &eta, double target, int order,
+                           const VectorXd &k, const VectorXd &q )
+{
+    int ne = eta.size();
+    double growth = std::pow(2.0, order);
+    std::vector<double> next;
+    next.reserve( 2*ne );
+    for (int e = 0; e < ne; e++)
+    {
+        if (eta(e) > target)
+        {
+            next.push_back( 0.5*mesh(e) );
+            next.push_back( 0.5*mesh(e) );
+        }
+        else if (e+1 < ne && eta(e+1) <= target && k(e) == k(e+1) && q(e) == q(e+1)
+                 && growth*std::hypot(eta(e), eta(e+1)) < 0.5*target)
+        {
+            next.push_back( mesh(e) + mesh(e+1) );
+            e++;
+        }
+        else
+        {
+            next.push_back( mesh(e) );
+        }
+    }
+    return Eigen::Map<const VectorXd>( next.data(), next.size() );
+}
+
+// everything of a solve that depends neither on q nor on the boundary
+// values, together with the inputs it was built from. It is never
+// changed once published, so model copies on other threads can share it.
+struct FactorizationCache
+{
+    VectorXd mesh;
+    VectorXd k; // per element
+    CoordType coord;
+    ElementType element;
+    SolverType solver;
+    double tolerance;
+
+    // banded path: condensed vertex matrix, the load is built per solve
+    TridiagonalSystem banded;
+    TridiagonalSolver tridiagonal;
+
+    // sparse path: system for zero boundary values, plus the columns
+    // of K that multiply bc_a and bc_b; the load is built per solve
+    SparseAssembler assembler;
+    VectorXd boundaryColumnA;
+    VectorXd boundaryColumnB;
+    SparseLinearSolver linear;
+    mutable std::mutex iterativeLock;
+};
 
 FiniteElementModel::FiniteElementModel()
 {
@@ -38,161 +109,956 @@ FiniteElementModel::FiniteElementModel()
     // solve k*T'' + q = r*c*Tt on 0.05 < x < 0.25,
     // with BC T(0.05) = 400 K and T(0.25) = 600 K
 
-    param.a = Value(0.0,"m"); // beginning of interval to solve
-    param.b = Value(2.0,"m"); // end of interval to solve
-    param.bc_a = Value(700.0,"K"); // boundary condition at x=a
-    param.bc_b = Value(300.0, "K"); // boundary condition at x=b
+    param.a = 0.0; // beginning of interval to solve, m
+    param.b = 2.0; // end of interval to solve, m
+    param.bc_a = 700.0; // boundary condition at x=a, K
+    param.bc_b = 300.0; // boundary condition at x=b, K
+
+    param.k = 2.0; // W/mK
+    param.q = 1000.0; // W/m^3
 
-    param.k = Value(2.0,"W/mK"); // W/mK
-    param.q = Value(1000.0, "W/m^3"); // W/m^3
+    param.rho = 2300.0; // kg/m^3
+    param.cp = 880.0; // J/kgK
+    param.t0 = 300.0; // K
 
     param.n = 6; // number of nodes used
-    param.dx = Value( (param.b.number() - param.a.number())/(param.n-1), "m"); // step value
+    updateStep(); // step value
 
     // set default coordinate system to be cartesian and SI units
     modelCoord = CoordType::CARTESIAN;
     modelUnits = UnitSystem::SI;
+    unitScales = unitScalesFor(modelUnits);
+
+    // linear elements with the banded direct solve are the default
+    modelElement = ElementType::LINEAR;
+    modelSolver = SolverType::BANDED;
+    solverTolerance = 1.0e-10;
 
+    // uniform mesh unless a tolerance is set
+    adaptiveTolerance = 0.0;
+    maxRefinements = 20;
+    computeSensitivities = false;
+
+    // constant k unless a curve is set
+    nonlinearMethod = NonlinearMethod::NEWTON;
+    nonlinearTolerance = 1.0e-10;
+    maxNonlinearIterations = 50;
 }
 
 FiniteElementSolution FiniteElementModel::findNodalSolution()
 {
-    // local matrices for linear element, derived by hand
+    PROFILE_SCOPE("model.solve");
+    VectorXd mesh = uniformMesh();
+    if (adaptiveTolerance <= 0.0)
+    {
+        FiniteElementSolution fes = solveOnMesh(mesh);
+        addSensitivities(mesh, fes);
+        return fes;
+    }
+
+    // adaptive mode: solve, estimate the error of every element, then
+    // split the elements over their share of the target and merge
+    // neighbours well below it, until the estimate meets the
+    // tolerance or the mesh stops changing
+    FiniteElementSolution fes;
+    double assemblyTime = 0.0;
+    double factorizationTime = 0.0;
+    double solveTime = 0.0;
+    double postProcessTime = 0.0;
+    for (int pass = 0; ; pass++)
+    {
+        fes = solveOnMesh(mesh);
+        if (fes.cancelled)
+        {
+            return fes;
+        }
+        assemblyTime += fes.stats.assemblyTime;
+        factorizationTime += fes.stats.factorizationTime;
+        solveTime += fes.stats.solveTime;
+        postProcessTime += fes.stats.postProcessTime;
+
+        VectorXd eta;
+        double norm;
+        {
+            PROFILE_SCOPE("model.estimate");
+            norm = estimateError(fes, mesh, eta);
+        }
+        fes.refinementPasses = pass;
+        fes.estimatedError = (norm > 0.0) ? eta.norm()/norm : 0.0;
+        if (fes.estimatedError <= adaptiveTolerance || pass >= maxRefinements)
+        {
+            break;
+        }
+
+        double target = adaptiveTolerance*norm/std::sqrt( (double)eta.size() );
+        VectorXd kElem, qElem;
+        elementMaterials(mesh, kElem, qElem);
+        VectorXd next = adaptMesh(mesh, eta, target, (int)modelElement, kElem, qElem);
+        if (next.size() == mesh.size() && next == mesh)
+        {
+            break;
+        }
+        mesh.swap(next);
+    }
+    fes.stats.assemblyTime = assemblyTime;
+    fes.stats.factorizationTime = factorizationTime;
+    fes.stats.solveTime = solveTime;
+    fes.stats.postProcessTime = postProcessTime;
+    addSensitivities(mesh, fes);
+
+    return fes;
+}
+
+void FiniteElementModel::addSensitivities( const VectorXd &mesh, FiniteElementSolution &fes )
+{
+    if (!computeSensitivities || fes.cancelled || !conductivityCurve.empty())
+    {
+        return;
+    }
+    PROFILE_SCOPE("model.sensitivities");
+
+    // T is linear in q and in the boundary values, so each derivative
+    // is the solution for a unit value of that input with the others
+    // at zero. Only the load changes, so every one of these is a
+    // substitution against the factorization the primal solve left in
+    // the cache; derivatives of a scalar output like T_max follow
+    // from the fields without an adjoint solve per output
+    FiniteElementParameters saved = param;
+    std::vector<MaterialLayer> savedLayers = layers;
+    for (size_t l = 0; l < layers.size(); l++)
+    {
+        layers[l].q = 0.0;
+    }
+    auto unitSolve = [&]( double q, double bc_a, double bc_b, VectorXd &out )
+    {
+        if (fes.cancelled)
+        {
+            return;
+        }
+        param.q = q;
+        param.bc_a = bc_a;
+        param.bc_b = bc_b;
+        FiniteElementSolution unit = solveOnMesh(mesh);
+        fes.cancelled = unit.cancelled;
+        fes.stats.assemblyTime += unit.stats.assemblyTime;
+        fes.stats.solveTime += unit.stats.solveTime;
+        out.swap(unit.nodalSolution);
+    };
+    SolutionSensitivities s;
+    unitSolve(0.0, 1.0, 0.0, s.bc_a);
+    unitSolve(0.0, 0.0, 1.0, s.bc_b);
+    if (layers.empty())
+    {
+        // with a single material T = (q/k)*w + boundary part, where w
+        // does not depend on k or q, so dT/dk = -(q/k)*dT/dq
+        unitSolve(1.0, 0.0, 0.0, s.q);
+        if (!fes.cancelled)
+        {
+            s.k = -(saved.q/saved.k)*s.q;
+        }
+    }
+    param = saved;
+    layers.swap(savedLayers);
+
+    if (fes.cancelled)
+    {
+        fes.nodalSolution.resize(0);
+        fes.nodalXVals.resize(0);
+        fes.boundaryValues.resize(0);
+        return;
+    }
+    fes.sensitivities = s;
+}
+
+VectorXd linearizedTemperatures( const FiniteElementSolution &sol, double dk, double dq,
+                                 double dbc_a, double dbc_b )
+{
+    const SolutionSensitivities &s = sol.sensitivities;
+    VectorXd T = sol.nodalSolution;
+    if (s.k.size() == T.size())
+    {
+        T += dk*s.k;
+    }
+    if (s.q.size() == T.size())
+    {
+        T += dq*s.q;
+    }
+    if (s.bc_a.size() == T.size())
+    {
+        T += dbc_a*s.bc_a;
+    }
+    if (s.bc_b.size() == T.size())
+    {
+        T += dbc_b*s.bc_b;
+    }
+    return T;
+}
+
+VectorXd FiniteElementModel::uniformMesh() const
+{
+    if (layers.empty())
+    {
+        return VectorXd::Constant( param.n - 1, param.dx );
+    }
 
-    double k = param.k.number();
-    double q = param.q.number();
-    double dx = param.dx.number();
-    double a = param.a.number();
-    //double b = param.b.number();
-    double bc_a = param.bc_a.number();
-    double bc_b = param.bc_b.number();
-    int n = param.n;
+    // interfaces inside (a, b) split the interval into segments, and
+    // the n-1 elements are shared out by segment length, at least one
+    // each, handing the rounding remainder to the largest fractions
+    std::vector<double> bounds(1, param.a);
+    for (size_t l = 0; l < layers.size(); l++)
+    {
+        if (layers[l].end > bounds.back() && layers[l].end < param.b)
+        {
+            bounds.push_back(layers[l].end);
+        }
+    }
+    bounds.push_back(param.b);
+    int segments = bounds.size() - 1;
+    int total = std::max(param.n - 1, segments);
+    double length = param.b - param.a;
 
-    Matrix2d ke;
-    ke << 1, -1,
-         -1, 1;
-    ke = (k/dx)*ke;
+    std::vector<int> count(segments);
+    int used = 0;
+    for (int s = 0; s < segments; s++)
+    {
+        double share = total*(bounds[s+1] - bounds[s])/length;
+        count[s] = std::max(1, (int)std::floor(share));
+        used += count[s];
+    }
+    while (used < total)
+    {
+        int best = 0;
+        double most = -1.0;
+        for (int s = 0; s < segments; s++)
+        {
+            double left = total*(bounds[s+1] - bounds[s])/length - count[s];
+            if (left > most)
+            {
+                most = left;
+                best = s;
+            }
+        }
+        count[best]++;
+        used++;
+    }
+
+    VectorXd mesh(used);
+    int e = 0;
+    for (int s = 0; s < segments; s++)
+    {
+        mesh.segment(e, count[s]).setConstant( (bounds[s+1] - bounds[s])/count[s] );
+        e += count[s];
+    }
+    return mesh;
+}
 
-    Matrix2d me;
+void FiniteElementModel::elementMaterials( const VectorXd &mesh, VectorXd &k, VectorXd &q ) const
+{
+    int ne = mesh.size();
+    if (layers.empty())
+    {
+        k = VectorXd::Constant(ne, param.k);
+        q = VectorXd::Constant(ne, param.q);
+        return;
+    }
+
+    // layers and elements are both in x order, one merged walk gives
+    // every element the material at its midpoint
+    k.resize(ne);
+    q.resize(ne);
+    size_t l = 0;
+    double x = param.a;
+    for (int e = 0; e < ne; e++)
+    {
+        double mid = x + 0.5*mesh(e);
+        while (l + 1 < layers.size() && layers[l].end < mid)
+        {
+            l++;
+        }
+        k(e) = layers[l].k;
+        q(e) = layers[l].q;
+        x = x + mesh(e);
+    }
+}
+
+void FiniteElementModel::elementStiffness( const VectorXd &mesh, const VectorXd &k,
+                                           Eigen::Ref<VectorXd> c ) const
+{
+    // every element matrix is a multiple of the reference matrices in
+    // LagrangeElement: stiffness c*Kref and load s*Fref with s = q*h.
+    // For linear elements this is the hand derived ke = (k/h)*[1 -1; -1 1],
+    // fe = (q*h/2)*[1; 1], and the cylindrical term adds (k/2)*Kref
     if (modelCoord == CoordType::CYLINDRICAL)
     {
-        me << 1, -1,
-             -1, 1;
-        me = (k/2.0)*me;
+        elementStiffnessFor<CoordType::CYLINDRICAL>(mesh, k, c);
     }
     else
     {
-        // make 0s if not using cylindrical coords
-        me << 0.0, 0.0,
-              0.0, 0.0;
+        elementStiffnessFor<CoordType::CARTESIAN>(mesh, k, c);
     }
+}
 
-    Vector2d fe;
-    fe << 1,1;
-    fe = (q*dx/2.0)*fe;
+template<CoordType Coord>
+void FiniteElementModel::elementStiffnessFor( const VectorXd &mesh, const VectorXd &k,
+                                              Eigen::Ref<VectorXd> c ) const
+{
+    if constexpr (CoordinateTerms<Coord>::radialStiffness != 0.0)
+    {
+        c = ( k.array()/mesh.array() + CoordinateTerms<Coord>::radialStiffness*k.array() ).matrix();
+    }
+    else
+    {
+        c = ( k.array()/mesh.array() ).matrix();
+    }
+}
 
-    // build global matrices
+FiniteElementSolution FiniteElementModel::solveOnMesh( const VectorXd &mesh )
+{
+    // build solution struct, the selected back-end fills in the
+    // nodal values, the boundary values and the solver statistics
+    FiniteElementSolution fes;
+    fes.cancelled = false;
+    fes.refinementPasses = 0;
+    fes.estimatedError = 0.0;
+    if (!conductivityCurve.empty())
+    {
+        // k(T), iterated without the factorization cache
+        solveNonlinear(*this, mesh, fes);
+    }
+    else
+    {
+        // the only place the coordinate system and the element order
+        // are looked at, everything below is compiled for the pair
+        typedef void (FiniteElementModel::*SolveKernel)( const VectorXd &, FiniteElementSolution & );
+        static const SolveKernel kernels[2][3] = {
+            { &FiniteElementModel::solveKernel<CoordType::CARTESIAN, 1>,
+              &FiniteElementModel::solveKernel<CoordType::CARTESIAN, 2>,
+              &FiniteElementModel::solveKernel<CoordType::CARTESIAN, 3> },
+            { &FiniteElementModel::solveKernel<CoordType::CYLINDRICAL, 1>,
+              &FiniteElementModel::solveKernel<CoordType::CYLINDRICAL, 2>,
+              &FiniteElementModel::solveKernel<CoordType::CYLINDRICAL, 3> } };
+        int coord = (modelCoord == CoordType::CYLINDRICAL) ? 1 : 0;
+        int order = std::clamp((int)modelElement, 1, 3);
+        (this->*kernels[coord][order - 1])(mesh, fes);
+    }
+    if (fes.cancelled)
+    {
+        return fes;
+    }
+    PROFILE_COUNTER("model.unknowns", fes.stats.unknowns);
+    PROFILE_COUNTER("model.iterations", fes.stats.iterations);
 
-    MatrixXd K = MatrixXd::Zero(n,n);
-    VectorXd F = VectorXd::Zero(n);
-    for (int i = 0; i < n-1; i++)
+    // make vect of x values for each node, including the nodes
+    // inside higher order elements
+    int order = (int)modelElement;
+    int ne = mesh.size();
+    VectorXd xvals(ne*order + 1);
+    double x = param.a;
+    for (int e = 0; e < ne; e++)
     {
-        K(i,i) = K(i,i) + ke(0,0) + me(0,0);
-        K(i,i+1) = K(i,i+1) + ke(0,1) + me(0,1);
-        K(i+1,i) = K(i+1,i) + ke(1,0) + me(1,0);
-        K(i+1,i+1) = K(i+1,i+1) + ke(1,1) + me(1,1);
-        F(i) = F(i) + fe(0);
-        F(i+1) = F(i+1) + fe(1);
+        double h = mesh(e)/order;
+        for (int j = 0; j < order; j++)
+        {
+            xvals(e*order + j) = x + j*h;
+        }
+        x = x + mesh(e);
     }
+    xvals(ne*order) = param.b;
+    fes.nodalXVals = xvals;
+
+    return fes;
+}
+
+bool FiniteElementModel::cacheMatches( const FactorizationCache &cache, const VectorXd &mesh,
+                                       const VectorXd &k ) const
+{
+    // the matrix inputs; q and the boundary values only enter the load
+    return cache.coord == modelCoord
+        && cache.element == modelElement && cache.solver == modelSolver
+        && cache.tolerance == solverTolerance
+        && cache.mesh.size() == mesh.size() && cache.mesh == mesh && cache.k == k;
+}
 
-    // solve for missing nodes
+std::shared_ptr<FactorizationCache> FiniteElementModel::newCache( const VectorXd &mesh,
+                                                                 VectorXd k ) const
+{
+    std::shared_ptr<FactorizationCache> cache = std::make_shared<FactorizationCache>();
+    cache->mesh = mesh;
+    cache->k = std::move(k);
+    cache->coord = modelCoord;
+    cache->element = modelElement;
+    cache->solver = modelSolver;
+    cache->tolerance = solverTolerance;
+    return cache;
+}
 
-    VectorXd answer = VectorXd::Zero(n-2); // two less since ignore values at ends of interval
-    MatrixXd Ki = K.block(1,1,n-2,n-2); //sub-matrix starting at (1,1) and going 2 elements over
-    VectorXd Fi = F.segment(1,n-2);
-    // subtract off values at boundaries
-    for (int i = 0; i < n-2; i++)
+template<CoordType Coord, int Order>
+void FiniteElementModel::solveKernel( const VectorXd &mesh, FiniteElementSolution &fes )
+{
+    if (modelSolver == SolverType::BANDED)
     {
-        Fi(i) = Fi(i) - K(1+i,0)*bc_a - K(1+i,n-1)*bc_b;
+        solveBanded<Coord, Order>(mesh, fes);
     }
-    //solve using Householder QR decomposition
-    answer = Ki.fullPivHouseholderQr().solve(Fi);
+    else
+    {
+        solveSparse<Coord, Order>(mesh, fes);
+    }
+}
 
-    // Post-Processing -- go back and get boundary conditions for derivatives
+bool FiniteElementModel::isCancelled() const
+{
+    return cancelCheck && cancelCheck();
+}
 
-    // set new nodes values into node vector
-    VectorXd nodes = VectorXd::Zero(n);
-    nodes(0) = bc_a;
-    for (int i = 1; i < n-1; i++)
+template<CoordType Coord, int Order>
+void FiniteElementModel::solveBanded( const VectorXd &mesh, FiniteElementSolution &fes )
+{
+    // interior nodes of higher order elements are condensed out, so
+    // the global system on the element vertices stays tridiagonal
+    constexpr typename CondensedElement<Order>::Data cond = CondensedElement<Order>::compute();
+
+    double bc_a = param.bc_a;
+    double bc_b = param.bc_b;
+    int n = mesh.size() + 1;
+
+    SolverStatistics &stats = fes.stats;
+    stats.solver = SolverType::BANDED;
+    stats.unknowns = (n > 2) ? n-2 : 0;
+    stats.iterations = 0;
+    stats.residual = 0.0;
+    stats.converged = true;
+    stats.reused = true;
+    stats.assemblyTime = 0.0;
+    stats.factorizationTime = 0.0;
+    stats.solveTime = 0.0;
+    stats.postProcessTime = 0.0;
+
+    Clock::time_point t0 = Clock::now();
+    VectorXd kElem, qElem;
+    elementMaterials(mesh, kElem, qElem);
+    stats.assemblyTime = secondsSince(t0);
+    PROFILE_INTERVAL("model.materials", t0);
+
+    std::shared_ptr<const FactorizationCache> cache = factorization;
+    if (!cache || !cacheMatches(*cache, mesh, kElem))
     {
-        nodes(i) = answer(i-1);
+        t0 = Clock::now();
+        std::shared_ptr<FactorizationCache> fresh = newCache(mesh, std::move(kElem));
+        stats.reused = false;
+
+        // build global matrices in banded storage, only the three
+        // diagonals of K are non-zero. Vertex i gets the right end of
+        // element i-1 and the left end of element i, so every diagonal
+        // is written once by a shifted array expression with no
+        // branches; the element factors go into lower first to save a
+        // temporary
+        TridiagonalSystem &K = fresh->banded;
+        K.lower.resize(n-1);
+        elementStiffnessFor<Coord>(mesh, fresh->k, K.lower);
+        K.diag.resize(n);
+        K.diag(0) = cond.vertexStiffness[0]*K.lower(0);
+        K.diag.segment(1, n-2) = cond.vertexStiffness[0]*K.lower.tail(n-2)
+            + cond.vertexStiffness[3]*K.lower.head(n-2);
+        K.diag(n-1) = cond.vertexStiffness[3]*K.lower(n-2);
+        K.upper = cond.vertexStiffness[1]*K.lower;
+        K.lower *= cond.vertexStiffness[2];
+        stats.assemblyTime += secondsSince(t0);
+        PROFILE_INTERVAL("model.assembly", t0);
+        if (isCancelled())
+        {
+            fes.cancelled = true;
+            return;
+        }
+
+        //factor interior block using tridiagonal LU decomposition
+        if (n > 2)
+        {
+            t0 = Clock::now();
+            fresh->tridiagonal.factorize( K.lower.segment(1,n-3), K.diag.segment(1,n-2),
+                                          K.upper.segment(1,n-3) );
+            stats.factorizationTime = secondsSince(t0);
+            PROFILE_INTERVAL("model.factorization", t0);
+            if (isCancelled())
+            {
+                fes.cancelled = true;
+                return;
+            }
+        }
+        cache = fresh;
+        factorization = fresh;
     }
+    const TridiagonalSystem &K = cache->banded;
+
+    // solve for missing nodes, only the load changes from one solve
+    // to the next
+
+    // set boundary values into node vector, interior nodes are
+    // solved in place in the middle of the same vector
+    t0 = Clock::now();
+    VectorXd F(n);
+    F(0) = cond.vertexLoad[0]*qElem(0)*mesh(0);
+    F.segment(1, n-2) = cond.vertexLoad[0]*qElem.tail(n-2).cwiseProduct(mesh.tail(n-2))
+        + cond.vertexLoad[1]*qElem.head(n-2).cwiseProduct(mesh.head(n-2));
+    F(n-1) = cond.vertexLoad[1]*qElem(n-2)*mesh(n-2);
+    VectorXd nodes = F;
+    nodes(0) = bc_a;
     nodes(n-1) = bc_b;
+    double rhsNorm = 0.0;
+    if (n > 2)
+    {
+        // two less since ignore values at ends of interval
+        Eigen::Ref<VectorXd> Fi = nodes.segment(1,n-2);
+        // subtract off values at boundaries
+        Fi(0) = Fi(0) - K.lower(0)*bc_a;
+        Fi(n-3) = Fi(n-3) - K.upper(n-2)*bc_b;
+        rhsNorm = Fi.norm();
+        stats.assemblyTime += secondsSince(t0);
+        PROFILE_INTERVAL("model.assembly", t0);
+
+        t0 = Clock::now();
+        cache->tridiagonal.solveInPlace(Fi);
+        stats.solveTime = secondsSince(t0);
+        PROFILE_INTERVAL("model.substitution", t0);
+    }
+
+    // Post-Processing -- go back and get boundary conditions for derivatives
 
     // now solve for BC vector:
+    t0 = Clock::now();
+    VectorXd bcvec = tridiagonalMultiply(K, nodes) - F;
 
-    VectorXd bcvec = VectorXd::Zero(n);
-    bcvec = K * nodes - F;
+    // interior entries of K*nodes - F are the residual of the solve
+    if (rhsNorm > 0.0)
+    {
+        stats.residual = bcvec.segment(1,n-2).norm()/rhsNorm;
+    }
+    stats.postProcessTime = secondsSince(t0);
+    PROFILE_INTERVAL("model.postprocess", t0);
 
-    // make vect of x values for each node
-    VectorXd xvals = VectorXd::Zero(n);
-    for (int i = 0; i < n; i++)
+    if constexpr (Order == 1)
+    {
+        fes.boundaryValues = bcvec;
+        fes.nodalSolution = nodes;
+    }
+    else
     {
-        xvals(i) = a + i*dx;
+        // recover the condensed interior nodes element by element
+        int dofs = (n-1)*Order + 1;
+        VectorXd full(dofs);
+        VectorXd fullbc = VectorXd::Zero(dofs);
+        VectorXd c(n-1);
+        elementStiffnessFor<Coord>(mesh, cache->k, c);
+        for (int e = 0; e < n-1; e++)
+        {
+            double ratio = qElem(e)*mesh(e)/c(e);
+            double T0 = nodes(e);
+            double T1 = nodes(e+1);
+            full(e*Order) = T0;
+            fullbc(e*Order) = bcvec(e);
+            for (int r = 0; r < Order-1; r++)
+            {
+                full(e*Order + r + 1) = ratio*cond.interiorLoad[r]
+                    - cond.interiorCoupling[r*2]*T0 - cond.interiorCoupling[r*2 + 1]*T1;
+            }
+        }
+        full(dofs-1) = nodes(n-1);
+        fullbc(dofs-1) = bcvec(n-1);
+        fes.boundaryValues = fullbc;
+        fes.nodalSolution = full;
     }
+}
 
-    // build solution struct
-    FiniteElementSolution fes;
-    fes.boundaryValues = bcvec;
-    fes.nodalSolution = nodes;
-    fes.nodalXVals = xvals;
+template<CoordType Coord, int Order>
+void FiniteElementModel::solveSparse( const VectorXd &mesh, FiniteElementSolution &fes )
+{
+    typedef LagrangeElement<Order> Element;
+    typedef Eigen::Matrix<double, Element::nodes, Element::nodes, Eigen::RowMajor> ElementMatrix;
+    typedef Eigen::Matrix<double, Element::nodes, 1> ElementVector;
+    constexpr std::array<double, Element::nodes*Element::nodes> Kref = Element::stiffness();
+    constexpr std::array<double, Element::nodes> Fref = Element::load();
 
-    return fes;
+    int n = mesh.size() + 1;
+    int dofs = (n-1)*Order + 1;
+
+    SolverStatistics &stats = fes.stats;
+    stats.solver = modelSolver;
+    stats.reused = true;
+    stats.factorizationTime = 0.0;
+
+    Clock::time_point t0 = Clock::now();
+    VectorXd kElem, qElem;
+    elementMaterials(mesh, kElem, qElem);
+    stats.assemblyTime = secondsSince(t0);
+    PROFILE_INTERVAL("model.materials", t0);
+
+    std::shared_ptr<const FactorizationCache> cache = factorization;
+    bool factored = true;
+    if (!cache || !cacheMatches(*cache, mesh, kElem))
+    {
+        t0 = Clock::now();
+        std::shared_ptr<FactorizationCache> fresh = newCache(mesh, std::move(kElem));
+        stats.reused = false;
+
+        // build global matrices from element triplets with zero
+        // boundary values; the boundary columns of K are kept to move
+        // the actual values over at solve time
+        VectorXd c(n-1);
+        elementStiffnessFor<Coord>(mesh, fresh->k, c);
+
+        Eigen::Matrix<double, Element::nodes, Element::nodes> ke;
+        ElementVector noLoad = ElementVector::Zero();
+        SparseAssembler &assembler = fresh->assembler;
+        assembler.reset(dofs);
+        assembler.reserve(Element::nodes*Element::nodes, n-1);
+        assembler.setDirichlet(0, 0.0);
+        assembler.setDirichlet(dofs-1, 0.0);
+        int elemDofs[Element::nodes];
+        for (int e = 0; e < n-1; e++)
+        {
+            ke = c(e)*Eigen::Map<const ElementMatrix>(Kref.data());
+            for (int j = 0; j < Element::nodes; j++)
+            {
+                elemDofs[j] = e*Order + j;
+            }
+            assembler.addElement(elemDofs, ke, noLoad);
+        }
+        assembler.finalize();
+        // the free dofs are 1..dofs-2 in order
+        fresh->boundaryColumnA = VectorXd( assembler.globalMatrix().col(0) ).segment(1, dofs-2);
+        fresh->boundaryColumnB = VectorXd( assembler.globalMatrix().col(dofs-1) ).segment(1, dofs-2);
+        stats.assemblyTime += secondsSince(t0);
+        PROFILE_INTERVAL("model.assembly", t0);
+        if (isCancelled())
+        {
+            fes.cancelled = true;
+            return;
+        }
+
+        fresh->linear.set_type(modelSolver);
+        fresh->linear.set_tolerance(solverTolerance);
+
+        t0 = Clock::now();
+        factored = fresh->linear.compute( assembler.reducedMatrix() );
+        stats.factorizationTime = secondsSince(t0);
+        PROFILE_INTERVAL("model.factorization", t0);
+        if (isCancelled())
+        {
+            fes.cancelled = true;
+            return;
+        }
+        // a failed factorization is used for this solve only, so the
+        // result is flagged and the next solve starts over
+        cache = fresh;
+        if (factored)
+        {
+            factorization = fresh;
+        }
+    }
+    const SparseAssembler &assembler = cache->assembler;
+    stats.unknowns = assembler.numFreeDofs();
+
+    // solve for missing nodes, the load is rebuilt from q and the
+    // boundary values only; local node j of element e is dof e*Order+j,
+    // so every local node is one strided array update
+    t0 = Clock::now();
+    VectorXd F = VectorXd::Zero(dofs);
+    for (int j = 0; j < Element::nodes; j++)
+    {
+        Eigen::Map<VectorXd, 0, Eigen::InnerStride<> >( F.data() + j, n-1, Eigen::InnerStride<>(Order) )
+            += Fref[j]*qElem.cwiseProduct(mesh);
+    }
+    VectorXd Fr = F.segment(1, dofs-2)
+        - param.bc_a*cache->boundaryColumnA - param.bc_b*cache->boundaryColumnB;
+    stats.assemblyTime += secondsSince(t0);
+    PROFILE_INTERVAL("model.assembly", t0);
+
+    t0 = Clock::now();
+    VectorXd answer;
+    if (modelSolver == SolverType::SPARSE_LDLT)
+    {
+        answer = cache->linear.solve( Fr, stats );
+    }
+    else
+    {
+        // the Eigen iterative solvers keep per-solve state
+        std::lock_guard<std::mutex> lock(cache->iterativeLock);
+        answer = cache->linear.solve( Fr, stats );
+    }
+    stats.converged = stats.converged && factored;
+    stats.solveTime = secondsSince(t0);
+    PROFILE_INTERVAL("model.substitution", t0);
+
+    // Post-Processing -- go back and get boundary conditions for derivatives
+    t0 = Clock::now();
+    VectorXd nodes(dofs);
+    nodes(0) = param.bc_a;
+    nodes.segment(1, dofs-2) = answer;
+    nodes(dofs-1) = param.bc_b;
+    fes.boundaryValues = assembler.globalMatrix()*nodes - F;
+    stats.postProcessTime = secondsSince(t0);
+    PROFILE_INTERVAL("model.postprocess", t0);
+    fes.nodalSolution = std::move(nodes);
 }
 
 
-//typical setter functions here:
+double FiniteElementModel::estimateError( const FiniteElementSolution &fes,
+                                          const VectorXd &mesh, VectorXd &eta ) const
+{
+    switch (modelElement)
+    {
+    case ElementType::QUADRATIC:
+        return estimateErrorWithOrder<2>(fes, mesh, eta);
+    case ElementType::CUBIC:
+        return estimateErrorWithOrder<3>(fes, mesh, eta);
+    default:
+        return estimateErrorWithOrder<1>(fes, mesh, eta);
+    }
+}
+
+template<int Order>
+double FiniteElementModel::estimateErrorWithOrder( const FiniteElementSolution &fes,
+                                                   const VectorXd &mesh, VectorXd &eta ) const
+{
+    // flux recovery (Zienkiewicz-Zhu) estimate: the flux k*T' sampled at
+    // element midpoints is interpolated to a continuous piecewise linear
+    // field, and its difference to the flux of the solution is measured
+    // in the energy norm, eta_e^2 = integral of (G - k*T')^2/k. The flux
+    // and not the gradient is continuous across material interfaces.
+    // Returns the energy norm of the recovered field for scaling. For
+    // quadratic and cubic elements the linear recovery is less accurate
+    // than the solution, so there the estimate errs on the high side.
+    typedef LagrangeElement<Order> Element;
+    int ne = mesh.size();
+    const VectorXd &h = mesh;
+    const VectorXd &T = fes.nodalSolution;
+    VectorXd k, q;
+    elementMaterials(mesh, k, q);
+
+    std::array<double, Element::nodes> dMid;
+    std::array<double, GaussRule::points*Element::nodes> dGauss;
+    for (int j = 0; j < Element::nodes; j++)
+    {
+        dMid[j] = Element::shapeDerivative(j, 0.5);
+        for (int g = 0; g < GaussRule::points; g++)
+        {
+            dGauss[g*Element::nodes + j] = Element::shapeDerivative(j, GaussRule::xi[g]);
+        }
+    }
+
+    VectorXd gMid(ne);
+    for (int e = 0; e < ne; e++)
+    {
+        double d = 0.0;
+        for (int j = 0; j < Element::nodes; j++)
+        {
+            d += T(e*Order + j)*dMid[j];
+        }
+        gMid(e) = k(e)*d/h(e);
+    }
+
+    // recovered flux at the vertices, on the line through the
+    // neighbouring midpoint values and extrapolated at the ends
+    VectorXd G(ne+1);
+    if (ne == 1)
+    {
+        G(0) = gMid(0);
+        G(1) = gMid(0);
+    }
+    else
+    {
+        for (int i = 1; i < ne; i++)
+        {
+            G(i) = (gMid(i-1)*h(i) + gMid(i)*h(i-1))/(h(i-1) + h(i));
+        }
+        G(0) = gMid(0) - (gMid(1) - gMid(0))*h(0)/(h(0) + h(1));
+        G(ne) = gMid(ne-1) + (gMid(ne-1) - gMid(ne-2))*h(ne-1)/(h(ne-2) + h(ne-1));
+    }
+
+    eta.resize(ne);
+    double norm2 = 0.0;
+    for (int e = 0; e < ne; e++)
+    {
+        double err2 = 0.0;
+        double ref2 = 0.0;
+        for (int g = 0; g < GaussRule::points; g++)
+        {
+            double xi = GaussRule::xi[g];
+            double grad = 0.0;
+            for (int j = 0; j < Element::nodes; j++)
+            {
+                grad += T(e*Order + j)*dGauss[g*Element::nodes + j];
+            }
+            double flux = k(e)*grad/h(e);
+            double rec = (1.0 - xi)*G(e) + xi*G(e+1);
+            err2 += GaussRule::weight[g]*(rec - flux)*(rec - flux);
+            ref2 += GaussRule::weight[g]*rec*rec;
+        }
+        eta(e) = std::sqrt(h(e)*err2/k(e));
+        norm2 += h(e)*ref2/k(e);
+    }
+    return std::sqrt(norm2);
+}
+
+VectorXd FiniteElementModel::analyticalSolution( const Eigen::Ref<const VectorXd> &x ) const
+{
+    double a = param.a;
+    double b = param.b;
+    double q = param.q;
+    double k = param.k;
+    Eigen::ArrayXd r = x.array();
+
+    // coordinate system is chosen once, the rest is one array expression
+    if (modelCoord == CoordType::CYLINDRICAL)
+    {
+        double C2 = param.bc_b + q/(4.0*k)*b*b;
+        return ( -q/(4.0*k)*r.square() + C2 ).matrix();
+    }
+    double C1 = ( (param.bc_b - param.bc_a) - (q/(2*k))*(a*a - b*b) )/(b - a);
+    double C2 = param.bc_a + (q/(2*k))*a*a - C1*a;
+    return ( (-q/(2*k)*r + C1)*r + C2 ).matrix();
+}
+
+VectorXd FiniteElementModel::analyticalGradient( const Eigen::Ref<const VectorXd> &x ) const
+{
+    double a = param.a;
+    double b = param.b;
+    double q = param.q;
+    double k = param.k;
+    Eigen::ArrayXd r = x.array();
+
+    if (modelCoord == CoordType::CYLINDRICAL)
+    {
+        return ( -q/(2.0*k)*r ).matrix();
+    }
+    double C1 = ( (param.bc_b - param.bc_a) - (q/(2*k))*(a*a - b*b) )/(b - a);
+    return ( -q/k*r + C1 ).matrix();
+}
+
+SolutionError FiniteElementModel::solutionError( const FiniteElementSolution &sol ) const
+{
+    switch (modelElement)
+    {
+    case ElementType::QUADRATIC:
+        return solutionErrorWithOrder<2>(sol);
+    case ElementType::CUBIC:
+        return solutionErrorWithOrder<3>(sol);
+    default:
+        return solutionErrorWithOrder<1>(sol);
+    }
+}
+
+template<int Order>
+SolutionError FiniteElementModel::solutionErrorWithOrder( const FiniteElementSolution &sol ) const
+{
+    // integrate by the same Gauss rule as the element matrices, with the
+    // closed form evaluated for all quadrature points in one call
+    typedef LagrangeElement<Order> Element;
+    constexpr int ng = GaussRule::points;
+    const VectorXd &T = sol.nodalSolution;
+    const VectorXd &x = sol.nodalXVals;
+    int ne = (T.size() - 1)/Order;
+
+    VectorXd xg(ne*ng);
+    for (int e = 0; e < ne; e++)
+    {
+        double x0 = x(e*Order);
+        double h = x((e+1)*Order) - x0;
+        for (int g = 0; g < ng; g++)
+        {
+            xg(e*ng + g) = x0 + GaussRule::xi[g]*h;
+        }
+    }
+    VectorXd exact = analyticalSolution(xg);
+    VectorXd exactGradient = analyticalGradient(xg);
+
+    SolutionError err;
+    err.linf = (T - analyticalSolution(x)).cwiseAbs().maxCoeff();
+    double l2 = 0.0;
+    double h1 = 0.0;
+    for (int e = 0; e < ne; e++)
+    {
+        double h = x((e+1)*Order) - x(e*Order);
+        for (int g = 0; g < ng; g++)
+        {
+            double value = 0.0;
+            double slope = 0.0;
+            for (int j = 0; j < Element::nodes; j++)
+            {
+                value += T(e*Order + j)*Element::shape(j, GaussRule::xi[g]);
+                slope += T(e*Order + j)*Element::shapeDerivative(j, GaussRule::xi[g]);
+            }
+            double dv = value - exact(e*ng + g);
+            double ds = slope/h - exactGradient(e*ng + g);
+            l2 += GaussRule::weight[g]*h*dv*dv;
+            h1 += GaussRule::weight[g]*h*ds*ds;
+            err.linf = std::max(err.linf, std::abs(dv));
+        }
+    }
+    err.l2 = std::sqrt(l2);
+    err.h1 = std::sqrt(h1);
+    return err;
+}
+
+
+//typical setter functions here, values come in the selected
+//unit system and are stored in SI:
+
+void FiniteElementModel::updateStep()
+{
+    param.dx = (param.b - param.a)/(param.n-1); // step value
+}
 
 void FiniteElementModel::set_n(int new_n)
 {
     param.n = new_n;
-    //QString oldunit = param.dx.unit()->symbol(); // update value without changing unit
-    QString oldunit = param.dx.unit().symbol(); // update value without changing unit
-    param.dx = Value( (param.b.number() - param.a.number())/(param.n-1), oldunit); // step value
+    updateStep();
 }
 
 void FiniteElementModel::set_a(double new_a)
 {
-    param.a = Value(new_a, "m");
-    QString oldunit = param.dx.unit().symbol(); // update value without changing unit
-    param.dx = Value( (param.b.number() - param.a.number())/(param.n-1), oldunit); // step value
+    param.a = toSI(unitScales.length, new_a);
+    updateStep();
 }
 
 void FiniteElementModel::set_b(double new_b)
 {
-    param.b = Value(new_b, "m");
-    QString oldunit = param.dx.unit().symbol(); // update value without changing unit
-    param.dx = Value( (param.b.number() - param.a.number())/(param.n-1), oldunit); // step value
+    param.b = toSI(unitScales.length, new_b);
+    updateStep();
 }
 
 void FiniteElementModel::set_bc_a(double new_bc_a)
 {
-    param.bc_a = Value(new_bc_a, "K");
+    param.bc_a = toSI(unitScales.temperature, new_bc_a);
 }
 
 void FiniteElementModel::set_bc_b(double new_bc_b)
 {
-    param.bc_b = Value(new_bc_b, "K");
+    param.bc_b = toSI(unitScales.temperature, new_bc_b);
 }
 
 void FiniteElementModel::set_k(double new_k)
 {
-    param.k = Value(new_k, "W/mK");
+    param.k = toSI(unitScales.conductivity, new_k);
 }
 
 void FiniteElementModel::set_q(double new_q)
 {
-    param.q = Value(new_q, "W/m^3");
+    param.q = toSI(unitScales.heatGeneration, new_q);
+}
+
+void FiniteElementModel::set_rho(double new_rho)
+{
+    param.rho = toSI(unitScales.density, new_rho);
+}
+
+void FiniteElementModel::set_cp(double new_cp)
+{
+    param.cp = toSI(unitScales.specificHeat, new_cp);
+}
+
+void FiniteElementModel::set_t0(double new_t0)
+{
+    param.t0 = toSI(unitScales.temperature, new_t0);
 }
 
 void FiniteElementModel::set_coord( CoordType new_coord )
@@ -200,31 +1066,203 @@ void FiniteElementModel::set_coord( CoordType new_coord )
     modelCoord = new_coord;
 }
 
-void FiniteElementModel::set_unit_sys( UnitSystem new_units )
+void FiniteElementModel::set_element( ElementType new_element )
 {
-    modelUnits = new_units;
-    if (modelUnits == UnitSystem::ENGLISH)
+    modelElement = new_element;
+}
+
+void FiniteElementModel::set_solver( SolverType new_solver )
+{
+    modelSolver = new_solver;
+}
+
+void FiniteElementModel::set_solver_tolerance( double new_tol )
+{
+    solverTolerance = new_tol;
+}
+
+void FiniteElementModel::set_cancel_check( std::function<bool()> check )
+{
+    cancelCheck = check;
+}
+
+void FiniteElementModel::set_adaptive_tolerance( double new_tol )
+{
+    adaptiveTolerance = new_tol;
+}
+
+void FiniteElementModel::set_max_refinements( int new_max )
+{
+    maxRefinements = new_max;
+}
+
+void FiniteElementModel::set_layers( const std::vector<MaterialLayer> &new_layers )
+{
+    layers.clear();
+    for (size_t l = 0; l < new_layers.size(); l++)
+    {
+        MaterialLayer layer;
+        layer.end = toSI(unitScales.length, new_layers[l].end);
+        layer.k = toSI(unitScales.conductivity, new_layers[l].k);
+        layer.q = toSI(unitScales.heatGeneration, new_layers[l].q);
+        layers.push_back(layer);
+    }
+    std::sort(layers.begin(), layers.end(),
+              [](const MaterialLayer &x, const MaterialLayer &y) { return x.end < y.end; });
+}
+
+void FiniteElementModel::set_conductivity_table( const std::vector<double> &T,
+                                                 const std::vector<double> &k )
+{
+    std::vector<double> siT, siK;
+    for (size_t i = 0; i < T.size() && i < k.size(); i++)
+    {
+        siT.push_back( toSI(unitScales.temperature, T[i]) );
+        siK.push_back( toSI(unitScales.conductivity, k[i]) );
+    }
+    conductivityCurve.set_table(siT, siK);
+}
+
+void FiniteElementModel::set_conductivity_polynomial( const std::vector<double> &coefficients )
+{
+    // substitute T = scale*T_SI + offset by Horner's scheme on the
+    // coefficient lists, then convert k itself
+    const UnitConversion &t = unitScales.temperature;
+    std::vector<double> si;
+    for (size_t i = coefficients.size(); i-- > 0; )
+    {
+        si.push_back(0.0);
+        for (size_t j = si.size() - 1; j > 0; j--)
+        {
+            si[j] = t.offset*si[j] + t.scale*si[j-1];
+        }
+        si[0] = t.offset*si[0] + coefficients[i];
+    }
+    if (!si.empty())
+    {
+        si[0] -= unitScales.conductivity.offset;
+    }
+    for (size_t j = 0; j < si.size(); j++)
+    {
+        si[j] /= unitScales.conductivity.scale;
+    }
+    conductivityCurve.set_polynomial(si);
+}
+
+void FiniteElementModel::clear_conductivity_curve()
+{
+    conductivityCurve.clear();
+}
+
+void FiniteElementModel::set_nonlinear_method( NonlinearMethod new_method )
+{
+    nonlinearMethod = new_method;
+}
+
+void FiniteElementModel::set_nonlinear_tolerance( double new_tol )
+{
+    nonlinearTolerance = new_tol;
+}
+
+void FiniteElementModel::set_max_nonlinear_iterations( int new_max )
+{
+    maxNonlinearIterations = new_max;
+}
+
+void FiniteElementModel::set_sensitivities( bool compute )
+{
+    computeSensitivities = compute;
+}
+
+void FiniteElementModel::shareFactorization( const FiniteElementModel &other )
+{
+    // only ever used if its inputs match at the next solve
+    factorization = other.factorization;
+}
+
+// appenders for solutionKey, fixed width and native byte order
+static void appendKey( std::string &key, double value )
+{
+    value = (value == 0.0) ? 0.0 : value; // -0 and +0 give the same solution
+    key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendKey( std::string &key, int64_t value )
+{
+    key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendKey( std::string &key, const std::vector<double> &values )
+{
+    appendKey(key, (int64_t)values.size());
+    for (size_t i = 0; i < values.size(); i++)
     {
-        param.a = param.a.convertTo("ft");
-        param.b = param.b.convertTo("ft");
-        param.bc_a = param.bc_a.convertTo("F");
-        param.bc_b = param.bc_b.convertTo("F");
-        param.k = param.k.convertTo("Btu/ft-hr-F");
-        param.q = param.q.convertTo("Btu/hr/ft^3");
+        appendKey(key, values[i]);
     }
-    else // default is SI
+}
+
+std::string FiniteElementModel::solutionKey() const
+{
+    // the unit system, the transient inputs and the factorization
+    // cache do not change the steady SI solution and are left out, as
+    // are settings the selected solver never reads
+    std::string key = "VMCKEY1";
+    appendKey(key, (int64_t)modelCoord);
+    appendKey(key, (int64_t)modelElement);
+    appendKey(key, (int64_t)modelSolver);
+    appendKey(key, param.a);
+    appendKey(key, param.b);
+    appendKey(key, param.bc_a);
+    appendKey(key, param.bc_b);
+    appendKey(key, param.k);
+    appendKey(key, param.q);
+    appendKey(key, (int64_t)param.n);
+    bool iterative = modelSolver != SolverType::BANDED && modelSolver != SolverType::SPARSE_LDLT;
+    appendKey(key, iterative ? solverTolerance : 0.0);
+    appendKey(key, adaptiveTolerance > 0.0 ? adaptiveTolerance : 0.0);
+    appendKey(key, (int64_t)(adaptiveTolerance > 0.0 ? maxRefinements : 0));
+    appendKey(key, (int64_t)layers.size());
+    for (size_t l = 0; l < layers.size(); l++)
     {
-        param.a = param.a.convertTo("m");
-        param.b = param.b.convertTo("m");
-        param.bc_a = param.bc_a.convertTo("K");
-        param.bc_b = param.bc_b.convertTo("K");
-        param.k = param.k.convertTo("W/mK");
-        param.q = param.q.convertTo("W/m^3");
+        appendKey(key, layers[l].end);
+        appendKey(key, layers[l].k);
+        appendKey(key, layers[l].q);
     }
+    appendKey(key, conductivityCurve.get_table_T());
+    appendKey(key, conductivityCurve.get_table_k());
+    appendKey(key, conductivityCurve.get_polynomial());
+    if (!conductivityCurve.empty())
+    {
+        appendKey(key, (int64_t)nonlinearMethod);
+        appendKey(key, nonlinearTolerance);
+        appendKey(key, (int64_t)maxNonlinearIterations);
+    }
+    appendKey(key, (int64_t)(computeSensitivities && conductivityCurve.empty()));
+    return key;
+}
+
+void FiniteElementModel::set_unit_sys( UnitSystem new_units )
+{
+    // stored values stay in SI, only the conversions change
+    modelUnits = new_units;
+    unitScales = unitScalesFor(modelUnits);
+}
+
+void FiniteElementModel::convertToDisplayUnits( FiniteElementSolution &sol )
+{
+    const UnitConversion &x = unitScales.length;
+    const UnitConversion &t = unitScales.temperature;
+    const UnitConversion &f = unitScales.heatFlux;
+    sol.nodalXVals = (sol.nodalXVals.array()*x.scale + x.offset).matrix();
+    sol.nodalSolution = (sol.nodalSolution.array()*t.scale + t.offset).matrix();
+    sol.boundaryValues *= f.scale;
+    // derivatives of a temperature difference, the offset drops out
+    sol.sensitivities.k *= t.scale/unitScales.conductivity.scale;
+    sol.sensitivities.q *= t.scale/unitScales.heatGeneration.scale;
 }
 
 
-//getter functions here:
+//getter functions here, values go out in the selected unit system:
 
 int FiniteElementModel::get_n()
 {
@@ -233,65 +1271,149 @@ int FiniteElementModel::get_n()
 
 double FiniteElementModel::get_a()
 {
-    return param.a.number();
+    return fromSI(unitScales.length, param.a);
 }
 
-QString FiniteElementModel::get_unit_a()
+std::string FiniteElementModel::get_unit_a()
 {
-    return param.a.unit().symbol();
+    return unitScales.length.symbol;
 }
 
 double FiniteElementModel::get_b()
 {
-    return param.b.number();
+    return fromSI(unitScales.length, param.b);
 }
 
-QString FiniteElementModel::get_unit_b()
+std::string FiniteElementModel::get_unit_b()
 {
-    return param.b.unit().symbol();
+    return unitScales.length.symbol;
 }
 
 double FiniteElementModel::get_bc_a()
 {
-    return param.bc_a.number();
+    return fromSI(unitScales.temperature, param.bc_a);
 }
 
-QString FiniteElementModel::get_unit_bc_a()
+std::string FiniteElementModel::get_unit_bc_a()
 {
-    return param.bc_a.unit().symbol();
+    return unitScales.temperature.symbol;
 }
 
 double FiniteElementModel::get_bc_b()
 {
-    return param.bc_b.number();
+    return fromSI(unitScales.temperature, param.bc_b);
 }
 
-QString FiniteElementModel::get_unit_bc_b()
+std::string FiniteElementModel::get_unit_bc_b()
 {
-    return param.bc_b.unit().symbol();
+    return unitScales.temperature.symbol;
 }
 
 double FiniteElementModel::get_k()
 {
-    return param.k.number();
+    return fromSI(unitScales.conductivity, param.k);
 }
 
-QString FiniteElementModel::get_unit_k()
+std::string FiniteElementModel::get_unit_k()
 {
-    return param.k.unit().symbol();
+    return unitScales.conductivity.symbol;
 }
 
 double FiniteElementModel::get_q()
 {
-    return param.q.number();
+    return fromSI(unitScales.heatGeneration, param.q);
 }
 
-QString FiniteElementModel::get_unit_q()
+std::string FiniteElementModel::get_unit_q()
 {
-    return param.q.unit().symbol();
+    return unitScales.heatGeneration.symbol;
+}
+
+double FiniteElementModel::get_rho()
+{
+    return fromSI(unitScales.density, param.rho);
+}
+
+std::string FiniteElementModel::get_unit_rho()
+{
+    return unitScales.density.symbol;
+}
+
+double FiniteElementModel::get_cp()
+{
+    return fromSI(unitScales.specificHeat, param.cp);
+}
+
+std::string FiniteElementModel::get_unit_cp()
+{
+    return unitScales.specificHeat.symbol;
+}
+
+double FiniteElementModel::get_t0()
+{
+    return fromSI(unitScales.temperature, param.t0);
+}
+
+std::string FiniteElementModel::get_unit_t0()
+{
+    return unitScales.temperature.symbol;
 }
 
 CoordType FiniteElementModel::get_coord()
 {
     return modelCoord;
 }
+
+ElementType FiniteElementModel::get_element()
+{
+    return modelElement;
+}
+
+SolverType FiniteElementModel::get_solver()
+{
+    return modelSolver;
+}
+
+double FiniteElementModel::get_adaptive_tolerance()
+{
+    return adaptiveTolerance;
+}
+
+std::vector<MaterialLayer> FiniteElementModel::get_layers()
+{
+    std::vector<MaterialLayer> out;
+    for (size_t l = 0; l < layers.size(); l++)
+    {
+        MaterialLayer layer;
+        layer.end = fromSI(unitScales.length, layers[l].end);
+        layer.k = fromSI(unitScales.conductivity, layers[l].k);
+        layer.q = fromSI(unitScales.heatGeneration, layers[l].q);
+        out.push_back(layer);
+    }
+    return out;
+}
+
+bool FiniteElementModel::has_conductivity_curve()
+{
+    return !conductivityCurve.empty();
+}
+
+NonlinearMethod FiniteElementModel::get_nonlinear_method()
+{
+    return nonlinearMethod;
+}
+
+bool FiniteElementModel::get_sensitivities()
+{
+    return computeSensitivities;
+}
+
+UnitSystem FiniteElementModel::get_unit_sys()
+{
+    return modelUnits;
+}
+
+const UnitScales &FiniteElementModel::get_unit_scales()
+{
+    return unitScales;
+}
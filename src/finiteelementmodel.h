@@ -22,55 +22,136 @@
 #define FINITEELEMENTMODEL_H
 
 #include <eigen3/Eigen/Dense>
-#include <eigen3/Eigen/LU>
 using Eigen::MatrixXd;
 using Eigen::Matrix2d;
 using Eigen::VectorXd;
 using Eigen::Vector2d;
 
-#include <KF6/KUnitConversion/KUnitConversion/Converter>
-#include <KF6/KUnitConversion/KUnitConversion/Value>
-using KUnitConversion::Value;
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "conductivitycurve.h"
+#include "lagrangeelement.h"
+#include "linearsolver.h"
+#include "unitsystem.h"
+
+// one iteration of a solve with temperature dependent conductivity
+typedef struct
+{
+    double residual; // norm of K(T)T - F on the free nodes before the update
+    double update; // largest temperature change, K
+    double assemblyTime; // seconds
+    double factorizationTime; // seconds
+    double solveTime; // seconds
+}
+NonlinearIteration;
+
+// derivatives of every nodal temperature with respect to one input,
+// K per unit of that input; empty if they were not asked for or do
+// not apply (k and q with layers, anything with k(T))
+typedef struct
+{
+    VectorXd k; // K per W/mK
+    VectorXd q; // K per W/m^3
+    VectorXd bc_a; // K per K
+    VectorXd bc_b; // K per K
+}
+SolutionSensitivities;
 
 // define a struct to hold info about solution to
-// the finite element problem
+// the finite element problem, always in SI units; the vectors hold
+// every node including those inside higher order elements
 typedef struct
 {
     VectorXd nodalSolution;
     VectorXd nodalXVals;
     VectorXd boundaryValues;
+    SolverStatistics stats; // times add up over every adaptive pass
+    bool cancelled; // solve was abandoned, vectors are empty
+    int refinementPasses; // adaptive mesh only, 0 for a uniform mesh
+    double estimatedError; // relative energy norm estimate, adaptive only
+    std::vector<NonlinearIteration> nonlinearHistory; // k(T) only, last pass
+    SolutionSensitivities sensitivities; // see set_sensitivities
 }
 FiniteElementSolution;
 
-// structure to hold matrices to use for solution
+// first order estimate of the nodal temperatures after changing k, q
+// and the boundary values by the given amounts, from the sensitivities
+// of sol and in the same units; inputs without a sensitivity count as 0
+VectorXd linearizedTemperatures( const FiniteElementSolution &sol, double dk, double dq,
+                                 double dbc_a, double dbc_b );
+
+// discretization error of a solution against the closed form one,
+// in SI units
+typedef struct
+{
+    double l2; // K*m^(1/2)
+    double linf; // K, largest over the nodes and quadrature points
+    double h1; // seminorm, error of the gradient, K*m^(-1/2)
+}
+SolutionError;
+
+// one region of a layered wall, from the end of the previous layer (or
+// a) up to end; the last layer also covers anything up to b
 typedef struct
 {
-    Value a; // beginning of interval to solve
-    Value b; // end of interval to solve
-    Value bc_a; // boundary condition at x=a
-    Value bc_b; // boundary condition at x=b
+    double end; // m
+    double k; // W/mK
+    double q; // W/m^3
+}
+MaterialLayer;
 
-    Value k; // W/mK
-    Value q; // W/m^3
+// structure to hold matrices to use for solution, plain SI
+// values so the solver never has to look at units
+typedef struct
+{
+    double a; // beginning of interval to solve, m
+    double b; // end of interval to solve, m
+    double bc_a; // boundary condition at x=a, K
+    double bc_b; // boundary condition at x=b, K
 
-    int n; // number of nodes used
-    Value dx; // step value
+    double k; // W/mK
+    double q; // W/m^3
+
+    // only used by transient runs
+    double rho; // density, kg/m^3
+    double cp; // specific heat, J/kgK
+    double t0; // uniform initial temperature, K
+
+    int n; // number of nodes used (element vertices)
+    double dx; // step value, m
 }
 FiniteElementParameters;
 
+// factorized global matrix kept between solves, see the .cpp
+struct FactorizationCache;
+
 // define types of Coordinates available to solver
 enum class CoordType
 {
     CARTESIAN, CYLINDRICAL
 };
 
-// define which unit system currently using
-enum class UnitSystem
+// what a coordinate system adds to the element matrices, resolved at
+// compile time in the solver kernels: the stiffness factor on Kref is
+// k/h + radialStiffness*k
+template<CoordType Coord>
+struct CoordinateTerms
 {
-    SI, ENGLISH
+    static constexpr double radialStiffness = (Coord == CoordType::CYLINDRICAL) ? 0.5 : 0.0;
 };
 
-// define new class for finite element model
+// iteration used when k depends on temperature
+enum class NonlinearMethod
+{
+    PICARD, // k frozen at the last iterate, symmetric, linear convergence
+    NEWTON // full Jacobian including dk/dT, quadratic convergence
+};
+
+// define new class for finite element model; the setters and
+// getters work in the selected unit system, everything else in SI
 class FiniteElementModel
 {
 
@@ -82,30 +163,133 @@ public:
     void set_bc_b( double new_bc_b );
     void set_k( double new_k );
     void set_q( double new_q );
+    void set_rho( double new_rho );
+    void set_cp( double new_cp );
+    void set_t0( double new_t0 );
     void set_n( int new_n );
     void set_coord( CoordType new_coord );
+    void set_element( ElementType new_element );
     void set_unit_sys( UnitSystem new_units );
+    void set_solver( SolverType new_solver );
+    void set_solver_tolerance( double new_tol );
+    // polled between solve phases, returning true abandons the solve
+    void set_cancel_check( std::function<bool()> check );
+    // relative error target for adaptive meshing, 0 keeps the uniform
+    // mesh of n nodes; otherwise n is only the starting mesh
+    void set_adaptive_tolerance( double new_tol );
+    void set_max_refinements( int new_max );
+    // piecewise materials in x order, replacing k and q; an empty list
+    // goes back to the single material
+    void set_layers( const std::vector<MaterialLayer> &new_layers );
+    // conductivity as a function of temperature, replacing k and the
+    // layer conductivities while set: (T, k) table points, or the
+    // coefficients c0, c1, ... of k = c0 + c1*T + ..., in the selected
+    // units; layer q still applies
+    void set_conductivity_table( const std::vector<double> &T, const std::vector<double> &k );
+    void set_conductivity_polynomial( const std::vector<double> &coefficients );
+    void clear_conductivity_curve();
+    void set_nonlinear_method( NonlinearMethod new_method );
+    // largest update relative to the largest temperature, both in K
+    void set_nonlinear_tolerance( double new_tol );
+    void set_max_nonlinear_iterations( int new_max );
+    // also return dT/dk, dT/dq, dT/dbc_a and dT/dbc_b, one extra
+    // substitution each against the factorization of the solve
+    void set_sensitivities( bool compute );
     int get_n();
     double get_a();
-    QString get_unit_a();
+    std::string get_unit_a();
     double get_b();
-    QString get_unit_b();
+    std::string get_unit_b();
     double get_bc_a();
-    QString get_unit_bc_a();
+    std::string get_unit_bc_a();
     double get_bc_b();
-    QString get_unit_bc_b();
+    std::string get_unit_bc_b();
     double get_k();
-    QString get_unit_k();
+    std::string get_unit_k();
     double get_q();
-    QString get_unit_q();
+    std::string get_unit_q();
+    double get_rho();
+    std::string get_unit_rho();
+    double get_cp();
+    std::string get_unit_cp();
+    double get_t0();
+    std::string get_unit_t0();
     CoordType get_coord();
+    ElementType get_element();
+    SolverType get_solver();
+    double get_adaptive_tolerance();
+    std::vector<MaterialLayer> get_layers();
+    bool has_conductivity_curve();
+    NonlinearMethod get_nonlinear_method();
+    bool get_sensitivities();
+    UnitSystem get_unit_sys();
+    const UnitScales &get_unit_scales();
+    // re-solves that only change q or the boundary values reuse the
+    // factorization of the last solve with the same matrix inputs
     FiniteElementSolution findNodalSolution();
+    // take over the factorization of a copy (e.g. a background solve)
+    void shareFactorization( const FiniteElementModel &other );
+    // canonical bytes of every SI input of a steady solve, the same for
+    // any unit system; equal keys give the same solution (see ResultCache)
+    std::string solutionKey() const;
+
+    // closed form steady solution for constant k and q, SI in and out,
+    // layers are not taken into account;
+    // the cylindrical one is the solid cylinder with T(b) = bc_b
+    VectorXd analyticalSolution( const Eigen::Ref<const VectorXd> &x ) const;
+    VectorXd analyticalGradient( const Eigen::Ref<const VectorXd> &x ) const;
+    // L2, Linf and H1 error of an SI solution from this model
+    SolutionError solutionError( const FiniteElementSolution &sol ) const;
+    // convert an SI solution to the selected unit system, in place
+    void convertToDisplayUnits( FiniteElementSolution &sol );
+
+    // element level pieces shared with the transient solver, SI
+    // element lengths, a mesh starts at a; with layers the mesh is
+    // uniform within each layer and has a vertex on every interface
+    VectorXd uniformMesh() const;
+    // k and q of every element as contiguous arrays
+    void elementMaterials( const VectorXd &mesh, VectorXd &k, VectorXd &q ) const;
+    // factor on Kref for every element, written into c
+    void elementStiffness( const VectorXd &mesh, const VectorXd &k, Eigen::Ref<VectorXd> c ) const;
+    bool isCancelled() const;
+
+private:
+    void updateStep();
+    FiniteElementSolution solveOnMesh( const VectorXd &mesh );
+    void addSensitivities( const VectorXd &mesh, FiniteElementSolution &fes );
+    bool cacheMatches( const FactorizationCache &cache, const VectorXd &mesh, const VectorXd &k ) const;
+    std::shared_ptr<FactorizationCache> newCache( const VectorXd &mesh, VectorXd k ) const;
+    double estimateError( const FiniteElementSolution &fes, const VectorXd &mesh, VectorXd &eta ) const;
+    // one kernel per coordinate system and element order, picked once
+    // per solve by solveOnMesh
+    template<CoordType Coord, int Order> void solveKernel( const VectorXd &mesh, FiniteElementSolution &fes );
+    template<CoordType Coord, int Order> void solveBanded( const VectorXd &mesh, FiniteElementSolution &fes );
+    template<CoordType Coord, int Order> void solveSparse( const VectorXd &mesh, FiniteElementSolution &fes );
+    template<CoordType Coord> void elementStiffnessFor( const VectorXd &mesh, const VectorXd &k,
+                                                       Eigen::Ref<VectorXd> c ) const;
+    template<int Order> double estimateErrorWithOrder( const FiniteElementSolution &fes,
+                                                      const VectorXd &mesh, VectorXd &eta ) const;
+    template<int Order> SolutionError solutionErrorWithOrder( const FiniteElementSolution &sol ) const;
 
 public:
 
     CoordType modelCoord; // keep track of which coordinate system model is using
+    ElementType modelElement; // shape functions, linear up to cubic
     UnitSystem modelUnits; // keep track of unit system
+    UnitScales unitScales; // conversions for modelUnits, set with it
     FiniteElementParameters param; //keep track of FEM parameters
+    std::vector<MaterialLayer> layers; // SI, empty = param.k and param.q everywhere
+    ConductivityCurve conductivityCurve; // SI, empty = constant k
+    NonlinearMethod nonlinearMethod;
+    double nonlinearTolerance; // relative temperature update
+    int maxNonlinearIterations;
+    SolverType modelSolver; // linear solver back-end for the global system
+    double solverTolerance; // relative tolerance for iterative solvers
+    double adaptiveTolerance; // relative error target, 0 = uniform mesh
+    int maxRefinements; // cap on adaptive passes
+    bool computeSensitivities; // fill in FiniteElementSolution::sensitivities
+    std::function<bool()> cancelCheck; // optional, set by background solves
+    std::shared_ptr<const FactorizationCache> factorization; // shared by copies
 };
 
 #endif // FINITEELEMENTMODEL_H
@@ -0,0 +1,484 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "finiteelementmodel2d.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <eigen3/Eigen/Sparse>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+// bilinear element on a rectangle of size hx by hy whose left edge is
+// at x0; local nodes run (0,0), (1,0), (1,1), (0,1) counter-clockwise.
+// A 2x2 Gauss rule is exact for both matrices, also with the radius
+// as weight of an r-z section.
+typedef struct
+{
+    double K[4][4]; // for k = 1
+    double F[4]; // for q = 1
+}
+QuadElement;
+
+static QuadElement quadElement( double x0, double hx, double hy, bool radial )
+{
+    static const double gauss[2] = { 0.5 - 0.5/std::sqrt(3.0), 0.5 + 0.5/std::sqrt(3.0) };
+    static const int corner[4][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+
+    QuadElement e {};
+    for (int gx = 0; gx < 2; gx++)
+    {
+        for (int gy = 0; gy < 2; gy++)
+        {
+            double xi = gauss[gx];
+            double eta = gauss[gy];
+            double w = 0.25*hx*hy*( radial ? x0 + xi*hx : 1.0 );
+            double N[4], Nx[4], Ny[4];
+            for (int a = 0; a < 4; a++)
+            {
+                double lx = corner[a][0] ? xi : 1.0 - xi;
+                double ly = corner[a][1] ? eta : 1.0 - eta;
+                double dlx = corner[a][0] ? 1.0 : -1.0;
+                double dly = corner[a][1] ? 1.0 : -1.0;
+                N[a] = lx*ly;
+                Nx[a] = dlx*ly/hx;
+                Ny[a] = lx*dly/hy;
+            }
+            for (int a = 0; a < 4; a++)
+            {
+                e.F[a] += w*N[a];
+                for (int b = 0; b < 4; b++)
+                {
+                    e.K[a][b] += w*( Nx[a]*Nx[b] + Ny[a]*Ny[b] );
+                }
+            }
+        }
+    }
+    return e;
+}
+
+FiniteElementModel2D::FiniteElementModel2D()
+{
+    // the default 1D problem stretched over a 2 m by 1 m plate with
+    // insulated top and bottom edges
+    param.a = 0.0;
+    param.b = 2.0;
+    param.c = 0.0;
+    param.d = 1.0;
+    param.edgeFixed = { true, true, false, false };
+    param.edgeValue = { 700.0, 300.0, 0.0, 0.0 };
+
+    param.k = 2.0; // W/mK
+    param.q = 1000.0; // W/m^3
+
+    param.nx = 101;
+    param.ny = 51;
+
+    modelCoord = CoordType::CARTESIAN;
+    modelUnits = UnitSystem::SI;
+    unitScales = unitScalesFor(modelUnits);
+    modelSolver = SolverType::SPARSE_LDLT;
+    solverTolerance = 1.0e-10;
+    threads = 0;
+}
+
+bool FiniteElementModel2D::isCancelled() const
+{
+    return cancelCheck && cancelCheck();
+}
+
+FiniteElementSolution2D FiniteElementModel2D::findNodalSolution()
+{
+    PROFILE_SCOPE("model2d.solve");
+    FiniteElementSolution2D fes;
+    fes.cancelled = true;
+    fes.stats = SolverStatistics {};
+    fes.stats.solver = (modelSolver == SolverType::BANDED) ? SolverType::SPARSE_LDLT : modelSolver;
+
+    const int nx = param.nx;
+    const int ny = param.ny;
+    const long nodes = (long)nx*ny;
+    const double hx = (param.b - param.a)/(nx - 1);
+    const double hy = (param.d - param.c)/(ny - 1);
+    const bool radial = (modelCoord == CoordType::CYLINDRICAL);
+    if (!(param.edgeFixed[0] || param.edgeFixed[1] || param.edgeFixed[2] || param.edgeFixed[3]))
+    {
+        return fes; // only insulated edges, the temperature level is undefined
+    }
+
+    Clock::time_point start = Clock::now();
+
+    // equation numbers in node order, -1 for nodes on a fixed edge
+    std::vector<int> equation(nodes);
+    VectorXd fixedValue = VectorXd::Zero(nodes);
+    int freeCount = 0;
+    for (int j = 0; j < ny; j++)
+    {
+        for (int i = 0; i < nx; i++)
+        {
+            long p = (long)j*nx + i;
+            int edge = -1;
+            if (i == 0 && param.edgeFixed[(int)GridEdge::LEFT])
+            {
+                edge = (int)GridEdge::LEFT;
+            }
+            else if (i == nx-1 && param.edgeFixed[(int)GridEdge::RIGHT])
+            {
+                edge = (int)GridEdge::RIGHT;
+            }
+            else if (j == 0 && param.edgeFixed[(int)GridEdge::BOTTOM])
+            {
+                edge = (int)GridEdge::BOTTOM;
+            }
+            else if (j == ny-1 && param.edgeFixed[(int)GridEdge::TOP])
+            {
+                edge = (int)GridEdge::TOP;
+            }
+            if (edge >= 0)
+            {
+                equation[p] = -1;
+                fixedValue(p) = param.edgeValue[edge];
+            }
+            else
+            {
+                equation[p] = freeCount++;
+            }
+        }
+    }
+
+    // element matrices only change along x, and only for r-z sections
+    std::vector<QuadElement> columns(radial ? nx - 1 : 1);
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        columns[i] = quadElement(param.a + i*hx, hx, hy, radial);
+    }
+
+    ThreadPool pool(threads);
+
+    // sparsity of the reduced matrix straight in compressed form: the
+    // free neighbours of a free node within its 3x3 stencil. Equation
+    // numbers grow with the node index, so the stencil order is sorted.
+    SparseMatrixXd K(freeCount, freeCount);
+    std::vector<int> rowLength(freeCount + 1, 0);
+    auto stencil = [&](int i, int j, auto &&visit)
+    {
+        for (int dj = -1; dj <= 1; dj++)
+        {
+            for (int di = -1; di <= 1; di++)
+            {
+                int ii = i + di;
+                int jj = j + dj;
+                if (ii >= 0 && ii < nx && jj >= 0 && jj < ny && equation[(long)jj*nx + ii] >= 0)
+                {
+                    visit( equation[(long)jj*nx + ii] );
+                }
+            }
+        }
+    };
+    pool.parallelFor(ny, [&](size_t j, int)
+    {
+        for (int i = 0; i < nx; i++)
+        {
+            int e = equation[(long)j*nx + i];
+            if (e >= 0)
+            {
+                stencil(i, (int)j, [&](int) { rowLength[e+1]++; });
+            }
+        }
+    });
+    for (int e = 0; e < freeCount; e++)
+    {
+        rowLength[e+1] += rowLength[e];
+    }
+    K.resizeNonZeros(rowLength[freeCount]);
+    int *outer = K.outerIndexPtr();
+    int *inner = K.innerIndexPtr();
+    double *values = K.valuePtr();
+    for (int e = 0; e <= freeCount; e++)
+    {
+        outer[e] = rowLength[e];
+    }
+    pool.parallelFor(ny, [&](size_t j, int)
+    {
+        for (int i = 0; i < nx; i++)
+        {
+            int e = equation[(long)j*nx + i];
+            if (e >= 0)
+            {
+                int slot = outer[e];
+                stencil(i, (int)j, [&](int f) { inner[slot] = f; values[slot] = 0.0; slot++; });
+            }
+        }
+    });
+
+    // element rows j and j+2 share no nodes, so the even rows and then
+    // the odd rows can be added into K and F without any locking
+    VectorXd F = VectorXd::Zero(freeCount);
+    const double k = param.k;
+    const double q = param.q;
+    for (int color = 0; color < 2; color++)
+    {
+        size_t rows = (ny - color)/2; // element rows of this color
+        pool.parallelFor(rows, [&](size_t index, int)
+        {
+            int j = 2*(int)index + color;
+            for (int i = 0; i < nx - 1; i++)
+            {
+                const QuadElement &el = columns[radial ? i : 0];
+                long base = (long)j*nx + i;
+                long node[4] = { base, base + 1, base + nx + 1, base + nx };
+                for (int a = 0; a < 4; a++)
+                {
+                    int ea = equation[node[a]];
+                    if (ea < 0)
+                    {
+                        continue;
+                    }
+                    F(ea) += q*el.F[a];
+                    for (int b = 0; b < 4; b++)
+                    {
+                        int eb = equation[node[b]];
+                        if (eb < 0)
+                        {
+                            F(ea) -= k*el.K[a][b]*fixedValue(node[b]);
+                            continue;
+                        }
+                        int slot = outer[ea];
+                        while (inner[slot] != eb)
+                        {
+                            slot++;
+                        }
+                        values[slot] += k*el.K[a][b];
+                    }
+                }
+            }
+        });
+    }
+    fes.stats.assemblyTime = secondsSince(start);
+    PROFILE_INTERVAL("model2d.assembly", start);
+    fes.stats.unknowns = freeCount;
+    if (isCancelled())
+    {
+        return fes;
+    }
+
+    start = Clock::now();
+    SparseLinearSolver linear;
+    linear.set_type(fes.stats.solver);
+    linear.set_tolerance(solverTolerance);
+    bool factored = linear.compute(K);
+    fes.stats.factorizationTime = secondsSince(start);
+    PROFILE_INTERVAL("model2d.factorization", start);
+    if (isCancelled())
+    {
+        return fes;
+    }
+
+    start = Clock::now();
+    VectorXd Tr = linear.solve(F, fes.stats);
+    fes.stats.converged = fes.stats.converged && factored;
+    fes.stats.solveTime = secondsSince(start);
+    PROFILE_INTERVAL("model2d.substitution", start);
+
+    start = Clock::now();
+    fes.nodalSolution = fixedValue;
+    for (long p = 0; p < nodes; p++)
+    {
+        if (equation[p] >= 0)
+        {
+            fes.nodalSolution(p) = Tr(equation[p]);
+        }
+    }
+    fes.nodalXVals = VectorXd::LinSpaced(nx, param.a, param.b);
+    fes.nodalYVals = VectorXd::LinSpaced(ny, param.c, param.d);
+    fes.stats.postProcessTime = secondsSince(start);
+    PROFILE_INTERVAL("model2d.postprocess", start);
+    fes.cancelled = false;
+    return fes;
+}
+
+void FiniteElementModel2D::convertToDisplayUnits( FiniteElementSolution2D &sol )
+{
+    const UnitConversion &x = unitScales.length;
+    const UnitConversion &t = unitScales.temperature;
+    sol.nodalXVals = (sol.nodalXVals.array()*x.scale + x.offset).matrix();
+    sol.nodalYVals = (sol.nodalYVals.array()*x.scale + x.offset).matrix();
+    sol.nodalSolution = (sol.nodalSolution.array()*t.scale + t.offset).matrix();
+}
+
+//setter functions, values come in the selected unit system:
+
+void FiniteElementModel2D::set_a( double new_a )
+{
+    param.a = toSI(unitScales.length, new_a);
+}
+
+void FiniteElementModel2D::set_b( double new_b )
+{
+    param.b = toSI(unitScales.length, new_b);
+}
+
+void FiniteElementModel2D::set_c( double new_c )
+{
+    param.c = toSI(unitScales.length, new_c);
+}
+
+void FiniteElementModel2D::set_d( double new_d )
+{
+    param.d = toSI(unitScales.length, new_d);
+}
+
+void FiniteElementModel2D::set_edge_value( GridEdge edge, double new_value )
+{
+    param.edgeFixed[(int)edge] = true;
+    param.edgeValue[(int)edge] = toSI(unitScales.temperature, new_value);
+}
+
+void FiniteElementModel2D::set_edge_insulated( GridEdge edge )
+{
+    param.edgeFixed[(int)edge] = false;
+}
+
+void FiniteElementModel2D::set_k( double new_k )
+{
+    param.k = toSI(unitScales.conductivity, new_k);
+}
+
+void FiniteElementModel2D::set_q( double new_q )
+{
+    param.q = toSI(unitScales.heatGeneration, new_q);
+}
+
+void FiniteElementModel2D::set_nx( int new_nx )
+{
+    param.nx = (new_nx < 2) ? 2 : new_nx;
+}
+
+void FiniteElementModel2D::set_ny( int new_ny )
+{
+    param.ny = (new_ny < 2) ? 2 : new_ny;
+}
+
+void FiniteElementModel2D::set_coord( CoordType new_coord )
+{
+    modelCoord = new_coord;
+}
+
+void FiniteElementModel2D::set_unit_sys( UnitSystem new_units )
+{
+    // stored values stay in SI, only the conversions change
+    modelUnits = new_units;
+    unitScales = unitScalesFor(modelUnits);
+}
+
+void FiniteElementModel2D::set_solver( SolverType new_solver )
+{
+    modelSolver = new_solver;
+}
+
+void FiniteElementModel2D::set_solver_tolerance( double new_tol )
+{
+    solverTolerance = new_tol;
+}
+
+void FiniteElementModel2D::set_threads( int new_threads )
+{
+    threads = new_threads;
+}
+
+void FiniteElementModel2D::set_cancel_check( std::function<bool()> check )
+{
+    cancelCheck = check;
+}
+
+//getter functions, values go out in the selected unit system:
+
+double FiniteElementModel2D::get_a()
+{
+    return fromSI(unitScales.length, param.a);
+}
+
+double FiniteElementModel2D::get_b()
+{
+    return fromSI(unitScales.length, param.b);
+}
+
+double FiniteElementModel2D::get_c()
+{
+    return fromSI(unitScales.length, param.c);
+}
+
+double FiniteElementModel2D::get_d()
+{
+    return fromSI(unitScales.length, param.d);
+}
+
+bool FiniteElementModel2D::get_edge_fixed( GridEdge edge )
+{
+    return param.edgeFixed[(int)edge];
+}
+
+double FiniteElementModel2D::get_edge_value( GridEdge edge )
+{
+    return fromSI(unitScales.temperature, param.edgeValue[(int)edge]);
+}
+
+double FiniteElementModel2D::get_k()
+{
+    return fromSI(unitScales.conductivity, param.k);
+}
+
+double FiniteElementModel2D::get_q()
+{
+    return fromSI(unitScales.heatGeneration, param.q);
+}
+
+int FiniteElementModel2D::get_nx()
+{
+    return param.nx;
+}
+
+int FiniteElementModel2D::get_ny()
+{
+    return param.ny;
+}
+
+CoordType FiniteElementModel2D::get_coord()
+{
+    return modelCoord;
+}
+
+UnitSystem FiniteElementModel2D::get_unit_sys()
+{
+    return modelUnits;
+}
+
+SolverType FiniteElementModel2D::get_solver()
+{
+    return modelSolver;
+}
@@ -0,0 +1,136 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef FINITEELEMENTMODEL2D_H
+#define FINITEELEMENTMODEL2D_H
+
+#include <eigen3/Eigen/Dense>
+using Eigen::VectorXd;
+
+#include <array>
+#include <functional>
+
+#include "finiteelementmodel.h"
+#include "linearsolver.h"
+#include "unitsystem.h"
+
+// edges of the rectangle a <= x <= b, c <= y <= d; for an r-z section
+// x is the radius and y the axial position
+enum class GridEdge
+{
+    LEFT, RIGHT, BOTTOM, TOP
+};
+
+// structure to hold the solution on the structured grid, SI units;
+// node (i,j) sits at (nodalXVals(i), nodalYVals(j)) and its value is
+// nodalSolution(j*nx + i), so only the grid lines are stored
+typedef struct
+{
+    VectorXd nodalSolution;
+    VectorXd nodalXVals;
+    VectorXd nodalYVals;
+    SolverStatistics stats;
+    bool cancelled; // solve was abandoned or no edge is fixed, vectors are empty
+}
+FiniteElementSolution2D;
+
+// plain SI values of the 2D problem
+typedef struct
+{
+    double a; // x (or r) range, m
+    double b;
+    double c; // y (or z) range, m
+    double d;
+    std::array<bool, 4> edgeFixed; // Dirichlet edge, else insulated
+    std::array<double, 4> edgeValue; // K, indexed by GridEdge
+
+    double k; // W/mK
+    double q; // W/m^3
+
+    int nx; // grid lines in x (or r)
+    int ny; // grid lines in y (or z)
+}
+FiniteElementParameters2D;
+
+// steady conduction k*laplace(T) + q = 0 on a rectangle, or on an r-z
+// section of a body of revolution, with bilinear quad elements on a
+// structured grid. Every edge is either held at a fixed temperature or
+// insulated; corners belong to the left and right edges first. With
+// insulated top and bottom edges a Cartesian grid gives the 1D
+// Cartesian model's nodal values. The r-z section does not match the 1D
+// cylindrical model: the r-z weak form weights everything by r and
+// converges to the exact axisymmetric solution, while the 1D model adds
+// a constant k/2 to the element stiffness in place of that weighting.
+// Like the 1D model, setters and getters use the selected unit system.
+class FiniteElementModel2D
+{
+
+public:
+    FiniteElementModel2D();
+    void set_a( double new_a );
+    void set_b( double new_b );
+    void set_c( double new_c );
+    void set_d( double new_d );
+    void set_edge_value( GridEdge edge, double new_value ); // also fixes the edge
+    void set_edge_insulated( GridEdge edge );
+    void set_k( double new_k );
+    void set_q( double new_q );
+    void set_nx( int new_nx );
+    void set_ny( int new_ny );
+    void set_coord( CoordType new_coord );
+    void set_unit_sys( UnitSystem new_units );
+    void set_solver( SolverType new_solver ); // BANDED falls back to LDLT
+    void set_solver_tolerance( double new_tol );
+    void set_threads( int new_threads ); // 0 = one per core
+    // polled between solve phases, returning true abandons the solve
+    void set_cancel_check( std::function<bool()> check );
+    double get_a();
+    double get_b();
+    double get_c();
+    double get_d();
+    bool get_edge_fixed( GridEdge edge );
+    double get_edge_value( GridEdge edge );
+    double get_k();
+    double get_q();
+    int get_nx();
+    int get_ny();
+    CoordType get_coord();
+    UnitSystem get_unit_sys();
+    SolverType get_solver();
+
+    FiniteElementSolution2D findNodalSolution();
+    // convert an SI solution to the selected unit system, in place
+    void convertToDisplayUnits( FiniteElementSolution2D &sol );
+
+private:
+    bool isCancelled() const;
+
+public:
+    CoordType modelCoord; // CYLINDRICAL means an r-z section
+    UnitSystem modelUnits;
+    UnitScales unitScales; // conversions for modelUnits, set with it
+    FiniteElementParameters2D param;
+    SolverType modelSolver;
+    double solverTolerance;
+    int threads;
+    std::function<bool()> cancelCheck;
+};
+
+#endif // FINITEELEMENTMODEL2D_H
@@ -0,0 +1,263 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef LAGRANGEELEMENT_H
+#define LAGRANGEELEMENT_H
+
+#include <array>
+
+// define which element shape functions are used
+enum class ElementType
+{
+    LINEAR = 1, QUADRATIC = 2, CUBIC = 3
+};
+
+// 4 point Gauss-Legendre rule mapped to [0,1], exact for polynomials
+// up to degree 7, which covers every matrix of the cubic element
+namespace GaussRule
+{
+    constexpr int points = 4;
+    constexpr double xi[points] = {
+        0.5 - 0.5*0.86113631159405257522, 0.5 - 0.5*0.33998104358485626480,
+        0.5 + 0.5*0.33998104358485626480, 0.5 + 0.5*0.86113631159405257522 };
+    constexpr double weight[points] = {
+        0.5*0.34785484513745385737, 0.5*0.65214515486254614263,
+        0.5*0.65214515486254614263, 0.5*0.34785484513745385737 };
+}
+
+// 1D Lagrange element of the given order on the reference interval
+// [0,1] with equally spaced nodes xi_j = j/Order. Local node j sits at
+// position j, so the two vertices are 0 and Order and the rest are
+// interior. All reference matrices are evaluated at compile time; for
+// an element of length h
+//   stiffness = (1/h)*Kref, load = h*Fref, mass = h*Mref
+template<int Order>
+struct LagrangeElement
+{
+    static constexpr int nodes = Order + 1;
+    static constexpr int interior = Order - 1;
+
+    static constexpr double node( int j )
+    {
+        return double(j)/Order;
+    }
+
+    static constexpr double shape( int i, double xi )
+    {
+        double value = 1.0;
+        for (int m = 0; m < nodes; m++)
+        {
+            if (m != i)
+            {
+                value *= (xi - node(m))/(node(i) - node(m));
+            }
+        }
+        return value;
+    }
+
+    static constexpr double shapeDerivative( int i, double xi )
+    {
+        double value = 0.0;
+        for (int l = 0; l < nodes; l++)
+        {
+            if (l == i)
+            {
+                continue;
+            }
+            double term = 1.0/(node(i) - node(l));
+            for (int m = 0; m < nodes; m++)
+            {
+                if (m != i && m != l)
+                {
+                    term *= (xi - node(m))/(node(i) - node(m));
+                }
+            }
+            value += term;
+        }
+        return value;
+    }
+
+    // Kref(i,j) = integral of N_i' N_j', row major
+    static constexpr std::array<double, nodes*nodes> stiffness()
+    {
+        std::array<double, nodes*nodes> K {};
+        for (int g = 0; g < GaussRule::points; g++)
+        {
+            for (int i = 0; i < nodes; i++)
+            {
+                for (int j = 0; j < nodes; j++)
+                {
+                    K[i*nodes + j] += GaussRule::weight[g]
+                        *shapeDerivative(i, GaussRule::xi[g])*shapeDerivative(j, GaussRule::xi[g]);
+                }
+            }
+        }
+        // constants are in the kernel, so every row sums to zero; set
+        // that exactly, otherwise the round-off acts like a spurious
+        // reaction term that grows with the square of the node count
+        for (int i = 0; i < nodes; i++)
+        {
+            double offDiagonal = 0.0;
+            for (int j = 0; j < nodes; j++)
+            {
+                offDiagonal += (j != i) ? K[i*nodes + j] : 0.0;
+            }
+            K[i*nodes + i] = -offDiagonal;
+        }
+        return K;
+    }
+
+    // Mref(i,j) = integral of N_i N_j, row major
+    static constexpr std::array<double, nodes*nodes> mass()
+    {
+        std::array<double, nodes*nodes> M {};
+        for (int g = 0; g < GaussRule::points; g++)
+        {
+            for (int i = 0; i < nodes; i++)
+            {
+                for (int j = 0; j < nodes; j++)
+                {
+                    M[i*nodes + j] += GaussRule::weight[g]
+                        *shape(i, GaussRule::xi[g])*shape(j, GaussRule::xi[g]);
+                }
+            }
+        }
+        return M;
+    }
+
+    // Fref(i) = integral of N_i
+    static constexpr std::array<double, nodes> load()
+    {
+        std::array<double, nodes> F {};
+        for (int g = 0; g < GaussRule::points; g++)
+        {
+            for (int i = 0; i < nodes; i++)
+            {
+                F[i] += GaussRule::weight[g]*shape(i, GaussRule::xi[g]);
+            }
+        }
+        return F;
+    }
+};
+
+// static condensation of the interior nodes of one element for a
+// stiffness c*Kref and load s*Fref, reduced to the two vertices:
+//   condensed stiffness = c*vertexStiffness (2x2, row major)
+//   condensed load = s*vertexLoad
+// and afterwards the interior values follow from the vertex values as
+//   T_int = (s/c)*interiorLoad - interiorCoupling*[T_0, T_Order]
+template<int Order>
+struct CondensedElement
+{
+    typedef LagrangeElement<Order> Element;
+    static constexpr int ni = (Order > 1) ? Order - 1 : 1;
+
+    typedef struct
+    {
+        std::array<double, 4> vertexStiffness;
+        std::array<double, 2> vertexLoad;
+        std::array<double, ni> interiorLoad; // Kii^-1 Fi
+        std::array<double, ni*2> interiorCoupling; // Kii^-1 Kiv, row major
+    }
+    Data;
+
+    static constexpr Data compute()
+    {
+        constexpr int n = Element::nodes;
+        constexpr std::array<double, n*n> K = Element::stiffness();
+        constexpr std::array<double, n> F = Element::load();
+        const int vtx[2] = { 0, Order };
+
+        Data d {};
+        // right hand sides [Fi | Kiv] solved against Kii by Gaussian
+        // elimination; Kii is symmetric positive definite, no pivoting
+        std::array<double, ni*ni> A {};
+        std::array<double, ni*3> B {};
+        for (int r = 0; r < Order - 1; r++)
+        {
+            for (int c = 0; c < Order - 1; c++)
+            {
+                A[r*ni + c] = K[(r+1)*n + (c+1)];
+            }
+            B[r*3 + 0] = F[r+1];
+            B[r*3 + 1] = K[(r+1)*n + vtx[0]];
+            B[r*3 + 2] = K[(r+1)*n + vtx[1]];
+        }
+        for (int p = 0; p < Order - 1; p++)
+        {
+            for (int r = p + 1; r < Order - 1; r++)
+            {
+                double m = A[r*ni + p]/A[p*ni + p];
+                for (int c = p; c < Order - 1; c++)
+                {
+                    A[r*ni + c] -= m*A[p*ni + c];
+                }
+                for (int c = 0; c < 3; c++)
+                {
+                    B[r*3 + c] -= m*B[p*3 + c];
+                }
+            }
+        }
+        for (int r = Order - 2; r >= 0; r--)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                double sum = B[r*3 + c];
+                for (int k = r + 1; k < Order - 1; k++)
+                {
+                    sum -= A[r*ni + k]*B[k*3 + c];
+                }
+                B[r*3 + c] = sum/A[r*ni + r];
+            }
+        }
+
+        for (int r = 0; r < Order - 1; r++)
+        {
+            d.interiorLoad[r] = B[r*3 + 0];
+            d.interiorCoupling[r*2 + 0] = B[r*3 + 1];
+            d.interiorCoupling[r*2 + 1] = B[r*3 + 2];
+        }
+
+        // Schur complement onto the vertices
+        for (int a = 0; a < 2; a++)
+        {
+            d.vertexLoad[a] = F[vtx[a]];
+            for (int b = 0; b < 2; b++)
+            {
+                d.vertexStiffness[a*2 + b] = K[vtx[a]*n + vtx[b]];
+            }
+            for (int r = 0; r < Order - 1; r++)
+            {
+                double Kvi = K[vtx[a]*n + (r+1)];
+                d.vertexLoad[a] -= Kvi*d.interiorLoad[r];
+                for (int b = 0; b < 2; b++)
+                {
+                    d.vertexStiffness[a*2 + b] -= Kvi*d.interiorCoupling[r*2 + b];
+                }
+            }
+        }
+        // same zero row sum as the full element, exactly symmetric
+        double coupling = 0.5*(d.vertexStiffness[1] + d.vertexStiffness[2]);
+        d.vertexStiffness = { -coupling, coupling, coupling, -coupling };
+        return d;
+    }
+};
+
+#endif // LAGRANGEELEMENT_H
@@ -0,0 +1,127 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "linearsolver.h"
+
+SparseLinearSolver::SparseLinearSolver()
+{
+    type = SolverType::SPARSE_LDLT;
+    tolerance = 1.0e-10;
+    maxIterations = -1; // let Eigen pick (twice the system size)
+    matrix = nullptr;
+}
+
+void SparseLinearSolver::set_type( SolverType new_type )
+{
+    type = new_type;
+}
+
+void SparseLinearSolver::set_tolerance( double new_tol )
+{
+    tolerance = new_tol;
+}
+
+void SparseLinearSolver::set_max_iterations( int new_max )
+{
+    maxIterations = new_max;
+}
+
+SolverType SparseLinearSolver::get_type() const
+{
+    return type;
+}
+
+bool SparseLinearSolver::compute( const SparseMatrixXd &A )
+{
+    matrix = &A;
+    switch (type)
+    {
+    case SolverType::CG_JACOBI:
+        cgJacobi.setTolerance(tolerance);
+        if (maxIterations > 0)
+        {
+            cgJacobi.setMaxIterations(maxIterations);
+        }
+        cgJacobi.compute(A);
+        return cgJacobi.info() == Eigen::Success;
+    case SolverType::CG_ICHOL:
+        cgIchol.setTolerance(tolerance);
+        if (maxIterations > 0)
+        {
+            cgIchol.setMaxIterations(maxIterations);
+        }
+        cgIchol.compute(A);
+        return cgIchol.info() == Eigen::Success;
+    case SolverType::BICGSTAB:
+        bicgstab.setTolerance(tolerance);
+        if (maxIterations > 0)
+        {
+            bicgstab.setMaxIterations(maxIterations);
+        }
+        bicgstab.compute(A);
+        return bicgstab.info() == Eigen::Success;
+    default:
+        // banded systems are handled by TridiagonalSolver, anything
+        // else routed here falls back to the sparse direct solver
+        ldlt.compute(A);
+        return ldlt.info() == Eigen::Success;
+    }
+}
+
+VectorXd SparseLinearSolver::solve( const VectorXd &b, SolverStatistics &stats ) const
+{
+    VectorXd x;
+    stats.iterations = 0;
+    stats.converged = true;
+    switch (type)
+    {
+    case SolverType::CG_JACOBI:
+        x = cgJacobi.solve(b);
+        stats.iterations = cgJacobi.iterations();
+        stats.converged = (cgJacobi.info() == Eigen::Success);
+        break;
+    case SolverType::CG_ICHOL:
+        x = cgIchol.solve(b);
+        stats.iterations = cgIchol.iterations();
+        stats.converged = (cgIchol.info() == Eigen::Success);
+        break;
+    case SolverType::BICGSTAB:
+        x = bicgstab.solve(b);
+        stats.iterations = bicgstab.iterations();
+        stats.converged = (bicgstab.info() == Eigen::Success);
+        break;
+    default:
+        x = ldlt.solve(b);
+        stats.converged = (ldlt.info() == Eigen::Success);
+        break;
+    }
+
+    // report the true relative residual, not the solver's estimate
+    double bnorm = b.norm();
+    if (matrix != nullptr && bnorm > 0.0)
+    {
+        stats.residual = ((*matrix)*x - b).norm()/bnorm;
+    }
+    else
+    {
+        stats.residual = 0.0;
+    }
+    return x;
+}
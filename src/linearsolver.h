@@ -0,0 +1,88 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef LINEARSOLVER_H
+#define LINEARSOLVER_H
+
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/SparseCholesky>
+#include <eigen3/Eigen/IterativeLinearSolvers>
+using Eigen::VectorXd;
+typedef Eigen::SparseMatrix<double> SparseMatrixXd;
+
+// define which linear solver back-end is used for the global system
+enum class SolverType
+{
+    BANDED, // tridiagonal direct solve, 1D linear elements only
+    SPARSE_LDLT, // sparse direct Cholesky-type factorization
+    CG_JACOBI, // conjugate gradient, diagonal preconditioner
+    CG_ICHOL, // conjugate gradient, incomplete Cholesky preconditioner
+    BICGSTAB // stabilized bi-conjugate gradient, diagonal preconditioner
+};
+
+// statistics about the last linear solve, reported with the solution
+typedef struct
+{
+    SolverType solver;
+    int unknowns; // size of the reduced system
+    int iterations; // 0 for direct solvers
+    double residual; // relative residual |Ax-b|/|b|
+    bool converged;
+    double assemblyTime; // seconds
+    double factorizationTime; // seconds, preconditioner setup for iterative
+    double solveTime; // seconds
+    double postProcessTime; // seconds, boundary values K*T - F
+    bool reused; // factorization kept from an earlier solve
+}
+SolverStatistics;
+
+// wraps the Eigen sparse solvers behind one interface so the
+// back-end can be picked at runtime
+class SparseLinearSolver
+{
+
+public:
+    SparseLinearSolver();
+    void set_type( SolverType new_type );
+    void set_tolerance( double new_tol );
+    void set_max_iterations( int new_max );
+    SolverType get_type() const;
+
+    // factorize (or build the preconditioner for) the matrix
+    bool compute( const SparseMatrixXd &A );
+    // solve against the last computed matrix, filling in iteration info
+    VectorXd solve( const VectorXd &b, SolverStatistics &stats ) const;
+
+private:
+    SolverType type;
+    double tolerance;
+    int maxIterations;
+    const SparseMatrixXd *matrix;
+
+    Eigen::SimplicialLDLT<SparseMatrixXd> ldlt;
+    Eigen::ConjugateGradient<SparseMatrixXd, Eigen::Lower|Eigen::Upper,
+                             Eigen::DiagonalPreconditioner<double> > cgJacobi;
+    Eigen::ConjugateGradient<SparseMatrixXd, Eigen::Lower|Eigen::Upper,
+                             Eigen::IncompleteCholesky<double> > cgIchol;
+    Eigen::BiCGSTAB<SparseMatrixXd, Eigen::DiagonalPreconditioner<double> > bicgstab;
+};
+
+#endif // LINEARSOLVER_H
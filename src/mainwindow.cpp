@@ -21,6 +21,11 @@
 
 #include "mainwindow.h"
 #include "finiteelementmodel.h"
+#include "threadpool.h"
+#include "plotdecimator.h"
+#include "solutionfile.h"
+#include "resultcache.h"
+#include "profiler.h"
 
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/LU>
@@ -30,23 +35,30 @@ using Eigen::VectorXd;
 using Eigen::Vector2d;
 
 #include <math.h>
+#include <algorithm>
+#include <array>
 #include <QApplication>
 #include <QLabel>
 #include <QComboBox>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QCheckBox>
+#include <QEvent>
+#include <QFileDialog>
 #include <QBoxLayout>
+#include <QDockWidget>
 #include <QFormLayout>
 #include <QPen>
+#include <QPlainTextEdit>
+#include <QStandardPaths>
+#include <QStatusBar>
+#include <QTimer>
 
 
 #include <KF6/KPlotting/KPlotObject>
+#include <KF6/KPlotting/KPlotPoint>
 #include <KF6/KPlotting/KPlotWidget>
 #include <KF6/KPlotting/KPlotAxis>
-#include <KF6/KUnitConversion/KUnitConversion/Converter>
-#include <KF6/KUnitConversion/KUnitConversion/Value>
-using KUnitConversion::Value;
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -62,6 +74,24 @@ MainWindow::MainWindow(QWidget *parent)
                        + QApplication::applicationVersion() + "</h2>" );
 
     model = new FiniteElementModel();
+    // the what-if curve is drawn from these without solving again
+    model->set_sensitivities(true);
+
+    // solves run on their own thread, a newer request supersedes
+    // whatever is still in flight
+    solvePool = new ThreadPool(1);
+    solveGeneration = 0;
+    // parameter sets solved before come back from the cache, across
+    // sessions through the result files in the user's cache directory;
+    // without a usable directory it is memory only
+    resultCache = new ResultCache();
+    std::string cacheError;
+    resultCache->set_directory( (QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                                 + "/results").toStdString(), cacheError );
+    editTimer = new QTimer(this);
+    editTimer->setSingleShot(true);
+    editTimer->setInterval(250);
+    connect(editTimer, &QTimer::timeout, this, &MainWindow::updateGraph);
 
     plot = new KPlotWidget(w);
     plot->setMinimumSize(500, 500);
@@ -71,6 +101,12 @@ MainWindow::MainWindow(QWidget *parent)
     po1 = new KPlotObject(Qt::cyan,  KPlotObject::Lines, 2);
     po2 = new KPlotObject(Qt::red,  KPlotObject::Lines, 2);
     po3 = new KPlotObject(Qt::yellow,  KPlotObject::Lines, 2);
+    po4 = new KPlotObject(Qt::green,  KPlotObject::Lines, 2);
+    // the solution curve is decimated to the plot width, redo that
+    // when the widget is resized
+    plottedColumns = 0;
+    analyticalKey.fill(0.0);
+    plot->installEventFilter(this);
 
     unitSystemSelector = new QComboBox(w);
     unitSystemSelector->addItem("SI (Metric)");
@@ -85,7 +121,16 @@ MainWindow::MainWindow(QWidget *parent)
     elemGeometrySelector = new QComboBox(w);
     elemGeometrySelector->addItem("Linear");
     elemGeometrySelector->addItem("Quadratic");
-    connect(elemGeometrySelector, &QComboBox::currentTextChanged, this, &MainWindow::updateCoordSystem);
+    elemGeometrySelector->addItem("Cubic");
+    connect(elemGeometrySelector, &QComboBox::currentTextChanged, this, &MainWindow::updateElementType);
+
+    solverSelector = new QComboBox(w);
+    solverSelector->addItem("Banded (Tridiagonal)");
+    solverSelector->addItem("Sparse LDLT");
+    solverSelector->addItem("CG (Jacobi)");
+    solverSelector->addItem("CG (Incomplete Cholesky)");
+    solverSelector->addItem("BiCGSTAB");
+    connect(solverSelector, &QComboBox::currentTextChanged, this, &MainWindow::updateSolver);
 
     // take defaults from model and put into text boxes
     editNumberElements = new QLineEdit();
@@ -102,27 +147,52 @@ MainWindow::MainWindow(QWidget *parent)
     editValK->setText( QString::number(model->get_k()) );
     editValQ = new QLineEdit();
     editValQ->setText( QString::number(model->get_q()) );
+    editAdaptiveTol = new QLineEdit();
+    editAdaptiveTol->setText( QString::number(model->get_adaptive_tolerance()) );
+    // typing restarts the timer, so a burst of edits gives one solve
+    QLineEdit *edits[] = { editNumberElements, editValA, editValB, editValBCA,
+                           editValBCB, editValK, editValQ, editAdaptiveTol };
+    for (QLineEdit *edit : edits)
+    {
+        connect(edit, &QLineEdit::textEdited, editTimer, qOverload<>(&QTimer::start));
+    }
+    // first order estimates from the last solution, no solve needed,
+    // so these redraw on every keystroke
+    editWhatIfK = new QLineEdit();
+    editWhatIfK->setText("0");
+    editWhatIfQ = new QLineEdit();
+    editWhatIfQ->setText("0");
+    connect(editWhatIfK, &QLineEdit::textEdited, this, &MainWindow::updateWhatIfGraph);
+    connect(editWhatIfQ, &QLineEdit::textEdited, this, &MainWindow::updateWhatIfGraph);
     // set up grid of info to set values for finite element model
     QFormLayout *numElemLayout = new QFormLayout();
     numElemLayout->addRow(tr("Unit System:"), unitSystemSelector);
     numElemLayout->addRow(tr("Geometry Used:"), geometrySelector);
     numElemLayout->addRow(tr("Element Geometry:"), elemGeometrySelector);
+    numElemLayout->addRow(tr("Linear Solver:"), solverSelector);
     numElemLayout->addRow(tr("&Number of Elements Used:"), editNumberElements);
-    numElemLayout->addRow(tr("Interval Start") + " [" + model->get_unit_a() + "]", editValA);
-    numElemLayout->addRow(tr("Interval End") + " [" + model->get_unit_b() + "]", editValB);
-    numElemLayout->addRow(tr("Boundary Value at Interval Start") + " [" + model->get_unit_bc_a() + "]", editValBCA);
-    numElemLayout->addRow(tr("Boundary Value at Interval End") + " [" + model->get_unit_bc_b() + "]", editValBCB);
-    numElemLayout->addRow(tr("Thermal Conductivity") + " [" + model->get_unit_k() + "]", editValK);
-    numElemLayout->addRow(tr("Heat Generation Rate") + " [" + model->get_unit_q() + "]", editValQ);
+    numElemLayout->addRow(tr("Adaptive Mesh Tolerance (0 = uniform):"), editAdaptiveTol);
+    numElemLayout->addRow(tr("Interval Start") + " [" + QString::fromStdString(model->get_unit_a()) + "]", editValA);
+    numElemLayout->addRow(tr("Interval End") + " [" + QString::fromStdString(model->get_unit_b()) + "]", editValB);
+    numElemLayout->addRow(tr("Boundary Value at Interval Start") + " [" + QString::fromStdString(model->get_unit_bc_a()) + "]", editValBCA);
+    numElemLayout->addRow(tr("Boundary Value at Interval End") + " [" + QString::fromStdString(model->get_unit_bc_b()) + "]", editValBCB);
+    numElemLayout->addRow(tr("Thermal Conductivity") + " [" + QString::fromStdString(model->get_unit_k()) + "]", editValK);
+    numElemLayout->addRow(tr("Heat Generation Rate") + " [" + QString::fromStdString(model->get_unit_q()) + "]", editValQ);
+    numElemLayout->addRow(tr("What-if Change in Conductivity [%]"), editWhatIfK);
+    numElemLayout->addRow(tr("What-if Change in Heat Generation [%]"), editWhatIfQ);
 
     btnUpdateGraph = new QPushButton(w);
     btnUpdateGraph->setText("Update Graph");
     connect(btnUpdateGraph, &QPushButton::clicked, this, &MainWindow::updateGraph);
 
     QPushButton *btnSavePlot = new QPushButton(w);
-    btnSavePlot->setText("Save Current Plot to PNG");
+    btnSavePlot->setText("Export Results...");
     connect(btnSavePlot, &QPushButton::clicked, this, &MainWindow::savePlot);
 
+    QPushButton *btnOpenResults = new QPushButton(w);
+    btnOpenResults->setText("Open Saved Results...");
+    connect(btnOpenResults, &QPushButton::clicked, this, &MainWindow::openResults);
+
     chkShowAnalyticSolution = new QCheckBox(w);
     chkShowAnalyticSolution->setText("Show the Real Solution");
     connect(chkShowAnalyticSolution, &QCheckBox::stateChanged, this, &MainWindow::updateAnalyticalGraph);
@@ -132,93 +202,272 @@ MainWindow::MainWindow(QWidget *parent)
     vlay->addWidget(chkShowAnalyticSolution);
     vlay->addWidget(btnUpdateGraph);
     vlay->addWidget(btnSavePlot);
+    vlay->addWidget(btnOpenResults);
 
     hlay->addLayout(vlay);
     hlay->addWidget(plot);
 
     setCentralWidget(w);
 
+#ifdef VARMACALC_PROFILING
+    // instrumented builds only: where the time of the solves and
+    // redraws went, with the raw data one click away for a ticket
+    QDockWidget *profileDock = new QDockWidget(tr("Profile"), this);
+    QWidget *profilePanel = new QWidget(profileDock);
+    QVBoxLayout *profileLayout = new QVBoxLayout(profilePanel);
+    profileView = new QPlainTextEdit(profilePanel);
+    profileView->setReadOnly(true);
+    profileView->setFont( QFont("monospace") );
+    QPushButton *btnSaveProfile = new QPushButton(profilePanel);
+    btnSaveProfile->setText("Save Profile...");
+    connect(btnSaveProfile, &QPushButton::clicked, this, &MainWindow::saveProfile);
+    QPushButton *btnResetProfile = new QPushButton(profilePanel);
+    btnResetProfile->setText("Reset");
+    connect(btnResetProfile, &QPushButton::clicked, this, &MainWindow::resetProfile);
+    profileLayout->addWidget(profileView);
+    profileLayout->addWidget(btnSaveProfile);
+    profileLayout->addWidget(btnResetProfile);
+    profileDock->setWidget(profilePanel);
+    addDockWidget(Qt::RightDockWidgetArea, profileDock);
+#endif
+
     updateGraph();
 }
 
 MainWindow::~MainWindow()
 {
-
+    // abandon any running solve and wait for the worker to exit
+    // before the window it reports back to goes away
+    solveGeneration++;
+    delete solvePool;
+    delete resultCache;
+    delete model;
 }
 
 void MainWindow::updateGraph()
 {
-    // set value and solve new finite element system
-    model->set_n( editNumberElements->text().toInt() );
-    model->set_a( editValA->text().toDouble() );
-    model->set_b( editValB->text().toDouble() );
-    model->set_bc_a( editValBCA->text().toDouble() );
-    model->set_bc_b( editValBCB->text().toDouble() );
-    model->set_k( editValK->text().toDouble() );
-    model->set_q( editValQ->text().toDouble() );
-    // calculate new solution
-    FiniteElementSolution sol =  model->findNodalSolution();
-    int n = model->get_n();
+    editTimer->stop();
+
+    // set value and solve new finite element system; only fields the
+    // user typed into are read back, the rest were written from the
+    // model and rounded for display, so switching units back and forth
+    // leaves the SI values exactly as they were
+    {
+        PROFILE_SCOPE("gui.ingest");
+        auto edited = [](QLineEdit *edit) {
+            bool modified = edit->isModified();
+            edit->setModified(false);
+            return modified;
+        };
+        if (edited(editNumberElements))
+        {
+            model->set_n( editNumberElements->text().toInt() );
+        }
+        if (edited(editValA))
+        {
+            model->set_a( editValA->text().toDouble() );
+        }
+        if (edited(editValB))
+        {
+            model->set_b( editValB->text().toDouble() );
+        }
+        if (edited(editValBCA))
+        {
+            model->set_bc_a( editValBCA->text().toDouble() );
+        }
+        if (edited(editValBCB))
+        {
+            model->set_bc_b( editValBCB->text().toDouble() );
+        }
+        if (edited(editValK))
+        {
+            model->set_k( editValK->text().toDouble() );
+        }
+        if (edited(editValQ))
+        {
+            model->set_q( editValQ->text().toDouble() );
+        }
+        if (edited(editAdaptiveTol))
+        {
+            model->set_adaptive_tolerance( editAdaptiveTol->text().toDouble() );
+        }
+    }
+
+    // calculate new solution in the background on a snapshot of the
+    // model, so later edits cannot race with the running solve
+    quint64 generation = ++solveGeneration;
+    FiniteElementModel snapshot = *model;
+    snapshot.set_cancel_check( [this, generation]() {
+        return solveGeneration.load() != generation;
+    });
+    statusBar()->showMessage(tr("Solving..."));
+
+    solvePool->submit( [this, snapshot, generation]() mutable {
+        if (solveGeneration.load() != generation)
+        {
+            return; // superseded before it even started
+        }
+        std::shared_ptr<const FiniteElementSolution> cached = resultCache->find(snapshot);
+        FiniteElementSolution result;
+        if (cached)
+        {
+            result = *cached;
+        }
+        else
+        {
+            result = snapshot.findNodalSolution();
+            if (result.cancelled)
+            {
+                return;
+            }
+            resultCache->insert(snapshot, std::make_shared<const FiniteElementSolution>(result));
+        }
+        // plot in the units the user is working in
+        snapshot.convertToDisplayUnits(result);
+        std::shared_ptr<const FiniteElementSolution> sol =
+            std::make_shared<const FiniteElementSolution>( std::move(result) );
+        bool fromCache = (cached != nullptr);
+        QMetaObject::invokeMethod(this, [this, generation, sol, snapshot, fromCache]() {
+            // keep the factorization, so a following edit of only q or
+            // the boundary values skips straight to the substitution
+            model->shareFactorization(snapshot);
+            showSolution(generation, sol, fromCache);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::showSolution(quint64 generation, std::shared_ptr<const FiniteElementSolution> sol, bool cached)
+{
+    if (generation != solveGeneration.load())
+    {
+        return; // an older result arriving late, a newer solve is pending
+    }
+    currentSolution = sol;
+
     double a = model->get_a();
     double b = model->get_b();
     plot->setLimits( a- 0.05, b+0.05, 250, 850);
 
     // create new plot
-    po2->clearPoints();
-    for (int i = 0; i < n; i++)
+    plottedColumns = 0;
+    plotSolution();
+    if (!plot->plotObjects().contains(po2))
     {
-        po2->addPoint( sol.nodalXVals(i), sol.nodalSolution(i) );
+        plot->addPlotObject(po2);
     }
 
-    plot->addPlotObject(po2);
-
     // make sure the analytical solution is also updated
     updateAnalyticalGraph();
+    updateWhatIfGraph();
 
     plot->update();
+    QString message = tr("Solved %1 unknowns in %2 ms")
+        .arg(sol->stats.unknowns)
+        .arg(1000.0*(sol->stats.assemblyTime + sol->stats.factorizationTime + sol->stats.solveTime), 0, 'f', 1);
+    if (cached)
+    {
+        ResultCacheStats counters = resultCache->stats();
+        message = tr("Cached solution with %1 unknowns (%2 hits, %3 misses)")
+            .arg(sol->stats.unknowns).arg(counters.hits).arg(counters.misses);
+    }
+    else if (sol->stats.reused)
+    {
+        message += tr(", factorization reused");
+    }
+    if (model->get_adaptive_tolerance() > 0.0)
+    {
+        message += tr(", %1 refinement passes, estimated error %2")
+            .arg(sol->refinementPasses)
+            .arg(sol->estimatedError, 0, 'g', 2);
+    }
+    statusBar()->showMessage(message);
+#ifdef VARMACALC_PROFILING
+    updateProfileView();
+#endif
+}
 
+void MainWindow::plotSolution()
+{
+    PROFILE_SCOPE("gui.plot");
+    // only the nodes that change the drawn pixels go into po2, so the
+    // redraw cost follows the plot width rather than the node count
+    int columns = plot->pixRect().width();
+    QRectF limits = plot->dataRect();
+    if (!currentSolution || columns <= 0
+        || (columns == plottedColumns && limits == plottedLimits))
+    {
+        return;
+    }
+    plottedColumns = columns;
+    plottedLimits = limits;
+
+    const FiniteElementSolution &sol = *currentSolution;
+    std::vector<int> kept = decimateMinMax( sol.nodalXVals, sol.nodalSolution,
+                                            limits.left(), limits.right(), columns );
+    QList<KPlotPoint*> points;
+    points.reserve(kept.size());
+    for (int i : kept)
+    {
+        points.append( new KPlotPoint(sol.nodalXVals(i), sol.nodalSolution(i)) );
+    }
+    po2->clearPoints();
+    po2->addPoints(points);
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == plot && event->type() == QEvent::Resize)
+    {
+        plotSolution();
+        updateAnalyticalGraph();
+        updateWhatIfGraph();
+    }
+    return QMainWindow::eventFilter(watched, event);
 }
 
 void MainWindow::updateAnalyticalGraph()
 {
+    PROFILE_SCOPE("gui.analytical");
     if (chkShowAnalyticSolution->isChecked())
     {
-        // get values from model
+        // one sample per pixel column over the range the solution plot
+        // uses; the curve is only evaluated again if something it
+        // depends on has changed
         double a = model->get_a();
         double b = model->get_b();
-        double bc_a = model->get_bc_a();
-        double bc_b = model->get_bc_b();
-        double q = model->get_q();
-        double k = model->get_k();
-
-        // constants for analytical solution
-        double C1 = 0.0;
-        double C2 = 0.0;
-        if (model->get_coord() == CoordType::CARTESIAN)
+        int columns = std::max(plot->pixRect().width(), 2);
+        std::array<double, 9> key = { a, b, model->get_bc_a(), model->get_bc_b(),
+                                      model->get_k(), model->get_q(),
+                                      double(model->get_coord()), double(model->get_unit_sys()),
+                                      double(columns) };
+        if (key == analyticalKey && !po3->points().isEmpty())
         {
-            C1 = ( (bc_b-bc_a)-(q/(2*k))*(a*a - b*b) )/(b-a);
-            C2 = bc_a + (q/(2*k))*a*a - C1*a;
+            return;
         }
-        else if (model->get_coord() == CoordType::CYLINDRICAL)
+        if (key != analyticalKey)
         {
-            C1 = 0.0;
-            C2 = bc_b + q/(4.0*k)*b*b;
+            analyticalKey = key;
+            analyticalX = Eigen::VectorXd::LinSpaced(columns + 1, a - 0.05, b + 0.05);
+
+            // the closed form lives in the model and works in SI units
+            const UnitScales &units = model->get_unit_scales();
+            Eigen::VectorXd xSI = ( (analyticalX.array() - units.length.offset)/units.length.scale ).matrix();
+            analyticalT = ( model->analyticalSolution(xSI).array()*units.temperature.scale
+                            + units.temperature.offset ).matrix();
         }
 
-
+        QList<KPlotPoint*> points;
+        points.reserve(analyticalX.size());
+        for (int i = 0; i < analyticalX.size(); i++)
+        {
+            points.append( new KPlotPoint(analyticalX(i), analyticalT(i)) );
+        }
         po3->clearPoints();
-        for (double x = a-0.05; x <= b+0.05; x += 0.01) {
-            // analytical solution for steady state, constant uniform heat gen
-            if (model->get_coord() == CoordType::CARTESIAN)
-            {
-                po3->addPoint( x, (-1*q)/(2*k)*x*x + C1*x + C2  );
-            }
-            else
-            {
-                po3->addPoint( x, -q/(4.0*k)*x*x + C1 + C2);
-            }
+        po3->addPoints(points);
+        if (!plot->plotObjects().contains(po3))
+        {
+            plot->addPlotObject(po3);
         }
-        plot->addPlotObject(po3);
         plot->update();
     }
     else
@@ -230,6 +479,42 @@ void MainWindow::updateAnalyticalGraph()
 
 }
 
+void MainWindow::updateWhatIfGraph()
+{
+    PROFILE_SCOPE("gui.whatif");
+    // linearized around the current solution, which is already in
+    // display units like the sensitivities; without them (layers or
+    // k(T)) or without a change there is nothing to draw
+    double dk = editWhatIfK->text().toDouble()/100.0*model->get_k();
+    double dq = editWhatIfQ->text().toDouble()/100.0*model->get_q();
+    int columns = plot->pixRect().width();
+    if (!currentSolution || currentSolution->sensitivities.k.size() == 0
+        || (dk == 0.0 && dq == 0.0) || columns <= 0)
+    {
+        po4->clearPoints();
+        plot->update();
+        return;
+    }
+
+    const FiniteElementSolution &sol = *currentSolution;
+    Eigen::VectorXd T = linearizedTemperatures(sol, dk, dq, 0.0, 0.0);
+    QRectF limits = plot->dataRect();
+    std::vector<int> kept = decimateMinMax( sol.nodalXVals, T, limits.left(), limits.right(), columns );
+    QList<KPlotPoint*> points;
+    points.reserve(kept.size());
+    for (int i : kept)
+    {
+        points.append( new KPlotPoint(sol.nodalXVals(i), T(i)) );
+    }
+    po4->clearPoints();
+    po4->addPoints(points);
+    if (!plot->plotObjects().contains(po4))
+    {
+        plot->addPlotObject(po4);
+    }
+    plot->update();
+}
+
 void MainWindow::updateCoordSystem(QString currentCoordText)
 {
     if (currentCoordText == "Cylindrical")
@@ -245,6 +530,22 @@ void MainWindow::updateCoordSystem(QString currentCoordText)
     plot->update();
 }
 
+void MainWindow::updateElementType(QString currentElementText)
+{
+    if (currentElementText == "Quadratic")
+    {
+        model->set_element( ElementType::QUADRATIC );
+    }
+    else if (currentElementText == "Cubic")
+    {
+        model->set_element( ElementType::CUBIC );
+    }
+    else // default is linear
+    {
+        model->set_element( ElementType::LINEAR );
+    }
+}
+
 void MainWindow::updateUnitSystem(QString currentUnitText)
 {
     if (currentUnitText == "US/English")
@@ -265,8 +566,169 @@ void MainWindow::updateUnitSystem(QString currentUnitText)
     editValQ->setText( QString::number( model->get_q() ) );
 }
 
+void MainWindow::updateSolver(QString currentSolverText)
+{
+    if (currentSolverText == "Sparse LDLT")
+    {
+        model->set_solver( SolverType::SPARSE_LDLT );
+    }
+    else if (currentSolverText == "CG (Jacobi)")
+    {
+        model->set_solver( SolverType::CG_JACOBI );
+    }
+    else if (currentSolverText == "CG (Incomplete Cholesky)")
+    {
+        model->set_solver( SolverType::CG_ICHOL );
+    }
+    else if (currentSolverText == "BiCGSTAB")
+    {
+        model->set_solver( SolverType::BICGSTAB );
+    }
+    else // default is banded
+    {
+        model->set_solver( SolverType::BANDED );
+    }
+}
+
 void MainWindow::savePlot()
 {
-    //saves plot widget as a PNG file
-    plot->grab().save("plot.png");
+    // the plot as an image, or the numbers behind it; the file type
+    // follows the chosen filter
+    QString selected;
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export Results"), "plot.png",
+        tr("PNG image (*.png);;CSV table (*.csv);;VarmaCalc results (*.vmcs)"), &selected);
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    if (selected.contains("*.png"))
+    {
+        plot->grab().save(fileName);
+        return;
+    }
+    if (!currentSolution)
+    {
+        statusBar()->showMessage(tr("Nothing solved yet, no results to export"));
+        return;
+    }
+
+    // the shown solution is already in display units
+    std::string error;
+    bool ok;
+    if (selected.contains("*.csv"))
+    {
+        CsvSolutionWriter writer;
+        ok = writer.open(fileName.toStdString(), error) && writer.write(*currentSolution);
+        if (!writer.close() && ok)
+        {
+            ok = false;
+            error = "cannot write " + fileName.toStdString();
+        }
+    }
+    else
+    {
+        SolutionFileInfo info;
+        info.units = model->get_unit_sys();
+        info.coord = model->get_coord();
+        info.element = model->get_element();
+        ok = writeSolutionBinary(fileName.toStdString(), *currentSolution, info, error);
+    }
+    statusBar()->showMessage( ok ? tr("Results written to %1").arg(fileName)
+                                 : QString::fromStdString(error) );
+}
+
+void MainWindow::openResults()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Saved Results"), QString(),
+        tr("VarmaCalc results (*.vmcs)"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    SolutionFile file;
+    std::string error;
+    if (!file.open(fileName.toStdString(), error))
+    {
+        statusBar()->showMessage( QString::fromStdString(error) );
+        return;
+    }
+    if (file.size() == 0)
+    {
+        statusBar()->showMessage(tr("%1 holds no nodes").arg(fileName));
+        return;
+    }
+
+    // a solve still running would replace what was loaded
+    solveGeneration++;
+    currentSolution = std::make_shared<const FiniteElementSolution>( file.toSolution() );
+    double first = currentSolution->nodalXVals(0);
+    double last = currentSolution->nodalXVals( currentSolution->nodalXVals.size()-1 );
+    plot->setLimits( first - 0.05, last + 0.05, 250, 850);
+    plottedColumns = 0;
+    plotSolution();
+    if (!plot->plotObjects().contains(po2))
+    {
+        plot->addPlotObject(po2);
+    }
+    updateWhatIfGraph(); // result files carry no sensitivities
+    plot->update();
+
+    QString message = tr("Loaded %1 nodes from %2").arg(file.size()).arg(fileName);
+    if (file.info().units != model->get_unit_sys())
+    {
+        message += tr(", stored in other units than selected");
+    }
+    statusBar()->showMessage(message);
+}
+
+#ifdef VARMACALC_PROFILING
+void MainWindow::updateProfileView()
+{
+    // totals since the last reset, timers in ms and counters as they are
+    QString text = tr("%1 %2 %3 %4\n").arg(tr("phase"), -22).arg(tr("count"), 7)
+        .arg(tr("total"), 11).arg(tr("mean"), 11);
+    std::vector<ProfileSummary> summary = Profiler::instance().summary();
+    for (const ProfileSummary &s : summary)
+    {
+        double scale = s.counter ? 1.0 : 1000.0;
+        text += QString("%1 %2 %3 %4\n")
+            .arg(QString::fromStdString(s.name), -22)
+            .arg(s.count, 7)
+            .arg(scale*s.total, 11, 'g', 4)
+            .arg(scale*s.total/s.count, 11, 'g', 4);
+    }
+    profileView->setPlainText(text);
+}
+
+void MainWindow::saveProfile()
+{
+    QString selected;
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Profile"), "profile.json",
+        tr("Profile summary (*.json);;Chrome trace (*.json)"), &selected);
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    std::string error;
+    bool ok;
+    if (selected.startsWith(tr("Chrome trace")))
+    {
+        ok = Profiler::instance().writeChromeTrace(fileName.toStdString(), error);
+    }
+    else
+    {
+        ok = Profiler::instance().writeSummaryJson(fileName.toStdString(), error);
+    }
+    statusBar()->showMessage( ok ? tr("Profile written to %1").arg(fileName)
+                                 : QString::fromStdString(error) );
+}
+
+void MainWindow::resetProfile()
+{
+    Profiler::instance().reset();
+    updateProfileView();
 }
+#endif
@@ -22,16 +22,24 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QRectF>
+#include <array>
+#include <atomic>
+#include <memory>
 class QComboBox;
 class QLineEdit;
 class QLabel;
 class QPushButton;
 class QCheckBox;
 class QVBoxLayout;
+class QTimer;
+class QPlainTextEdit;
 class KPlotWidget;
 class KPlotObject;
 
 #include "finiteelementmodel.h"
+class ThreadPool;
+class ResultCache;
 
 class MainWindow : public QMainWindow
 {
@@ -44,15 +52,33 @@ public:
 private slots:
     void updateGraph();
     void updateAnalyticalGraph();
+    void updateWhatIfGraph();
     void updateCoordSystem(QString currentCoordText);
+    void updateElementType(QString currentElementText);
     void updateUnitSystem(QString currentUnitText);
+    void updateSolver(QString currentSolverText);
     void savePlot();
+    void openResults();
+#ifdef VARMACALC_PROFILING
+    void saveProfile();
+    void resetProfile();
+#endif
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private:
+    void showSolution(quint64 generation, std::shared_ptr<const FiniteElementSolution> sol, bool cached);
+    void plotSolution();
+#ifdef VARMACALC_PROFILING
+    void updateProfileView();
+#endif
+
     //QVBoxLayout *vlay;
     QComboBox *unitSystemSelector;
     QComboBox *geometrySelector;
     QComboBox *elemGeometrySelector;
+    QComboBox *solverSelector;
     QLineEdit *editNumberElements;
     QLineEdit *editValA;
     QLineEdit *editValB;
@@ -60,11 +86,27 @@ private:
     QLineEdit *editValBCB;
     QLineEdit *editValK;
     QLineEdit *editValQ;
+    QLineEdit *editAdaptiveTol;
+    QLineEdit *editWhatIfK; // percent change, drawn from the sensitivities
+    QLineEdit *editWhatIfQ;
     QPushButton *btnUpdateGraph;
     QCheckBox *chkShowAnalyticSolution;
     FiniteElementModel *model;
+    std::shared_ptr<const FiniteElementSolution> currentSolution;
+    ThreadPool *solvePool; // single background thread for solves
+    ResultCache *resultCache; // earlier solutions, also from past sessions
+    std::atomic<quint64> solveGeneration; // bumped by every new request
+    QTimer *editTimer; // coalesces rapid edits into one solve
     KPlotWidget *plot;
-    KPlotObject *po1, *po2, *po3;
+    KPlotObject *po1, *po2, *po3, *po4;
+    int plottedColumns; // pixel width po2 was decimated for, 0 = stale
+    QRectF plottedLimits; // data limits po2 was decimated for
+    std::array<double, 9> analyticalKey; // inputs po3 was sampled for
+    Eigen::VectorXd analyticalX; // sampled analytical curve, display units
+    Eigen::VectorXd analyticalT;
+#ifdef VARMACALC_PROFILING
+    QPlainTextEdit *profileView; // phase totals, refreshed after each solve
+#endif
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,376 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "nonlinearsolver.h"
+#include "tridiagonalsolver.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/SparseCholesky>
+#include <eigen3/Eigen/SparseLU>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+template<CoordType Coord, int Order>
+static void solveKernel( const FiniteElementModel &model, const VectorXd &mesh,
+                            FiniteElementSolution &fes )
+{
+    typedef LagrangeElement<Order> Element;
+    constexpr int nn = Element::nodes;
+    typedef Eigen::Matrix<double, nn, nn> ElementMatrix;
+    typedef Eigen::Matrix<double, nn, 1> ElementVector;
+
+    // shape functions and reference derivatives at the Gauss points
+    ElementVector N[GaussRule::points];
+    ElementVector dN[GaussRule::points];
+    for (int g = 0; g < GaussRule::points; g++)
+    {
+        for (int j = 0; j < nn; j++)
+        {
+            N[g](j) = Element::shape(j, GaussRule::xi[g]);
+            dN[g](j) = Element::shapeDerivative(j, GaussRule::xi[g]);
+        }
+    }
+    constexpr std::array<double, nn> Fref = Element::load();
+    ElementVector load;
+    for (int j = 0; j < nn; j++)
+    {
+        load(j) = Fref[j];
+    }
+
+    const ConductivityCurve &curve = model.conductivityCurve;
+    const FiniteElementParameters &param = model.param;
+    bool newton = model.nonlinearMethod == NonlinearMethod::NEWTON;
+    int ne = mesh.size();
+    int dofs = ne*Order + 1;
+    int nfree = dofs - 2;
+
+    SolverStatistics &stats = fes.stats;
+    stats.solver = (Order == 1) ? SolverType::BANDED : SolverType::SPARSE_LDLT;
+    stats.unknowns = nfree;
+    stats.iterations = 0;
+    stats.residual = 0.0;
+    stats.converged = false;
+    stats.reused = false;
+    stats.factorizationTime = 0.0;
+    stats.solveTime = 0.0;
+    fes.nonlinearHistory.clear();
+
+    Clock::time_point t0 = Clock::now();
+
+    // the stiffness per unit conductivity is (1/h)*Kref, plus (1/2)*Kref
+    // in cylindrical coordinates, see elementStiffness(); k(T) moves
+    // inside the integral
+    VectorXd kElem, qElem;
+    model.elementMaterials(mesh, kElem, qElem);
+    VectorXd scale = mesh.cwiseInverse();
+    if constexpr (CoordinateTerms<Coord>::radialStiffness != 0.0)
+    {
+        scale.array() += CoordinateTerms<Coord>::radialStiffness;
+    }
+
+    // load and starting guess, a straight line between the boundary values
+    VectorXd F = VectorXd::Zero(dofs);
+    VectorXd T(dofs);
+    double x = param.a;
+    double slope = (param.bc_b - param.bc_a)/(param.b - param.a);
+    for (int e = 0; e < ne; e++)
+    {
+        F.segment<nn>(e*Order) += (qElem(e)*mesh(e))*load;
+        for (int j = 0; j < Order; j++)
+        {
+            T(e*Order + j) = param.bc_a + slope*(x + j*mesh(e)/Order - param.a);
+        }
+        x += mesh(e);
+    }
+    T(0) = param.bc_a;
+    T(dofs-1) = param.bc_b;
+
+    // free-free block of the global matrix, global node d is unknown
+    // d-1. A node couples to every node of the elements it belongs to,
+    // so the rows of each column are contiguous and the CSC pattern is
+    // written directly; an element entry (r,c) then sits at
+    // outer[c] + r - (first row of c)
+    SparseMatrixXd J(nfree, nfree);
+    std::vector<int> firstRow(nfree);
+    if (nfree > 0)
+    {
+        int *outer = J.outerIndexPtr();
+        outer[0] = 0;
+        for (int c = 0; c < nfree; c++)
+        {
+            int d = c + 1;
+            int start = d - d % Order;
+            int lo = (d % Order == 0) ? start - Order : start;
+            int hi = start + Order;
+            firstRow[c] = std::max(lo, 1) - 1;
+            outer[c+1] = outer[c] + std::min(hi, dofs - 2) - 1 - firstRow[c] + 1;
+        }
+        J.resizeNonZeros(outer[nfree]);
+        int *inner = J.innerIndexPtr();
+        for (int c = 0; c < nfree; c++)
+        {
+            for (int p = outer[c]; p < outer[c+1]; p++)
+            {
+                inner[p] = firstRow[c] + p - outer[c];
+            }
+        }
+    }
+
+    // Picard matrices are symmetric, the Newton Jacobian is not
+    TridiagonalSolver thomas;
+    VectorXd lower, diag, upper;
+    Eigen::SimplicialLDLT<SparseMatrixXd> ldlt;
+    Eigen::SparseLU<SparseMatrixXd> lu;
+    if (Order == 1)
+    {
+        lower.resize( std::max(nfree-1, 0) );
+        diag.resize(nfree);
+        upper.resize( std::max(nfree-1, 0) );
+    }
+    else if (nfree > 0)
+    {
+        if (newton)
+        {
+            lu.analyzePattern(J);
+        }
+        else
+        {
+            ldlt.analyzePattern(J);
+        }
+    }
+    stats.assemblyTime = secondsSince(t0);
+    PROFILE_INTERVAL("nonlinear.setup", t0);
+
+    // residual K(T)T - F into residual, and K(T) (plus the dk/dT term)
+    // into the values of J if asked for; physical goes false if k(T)
+    // is not positive and finite at some quadrature point, e.g. a
+    // polynomial that turns negative at the temperatures reached
+    VectorXd residual(dofs);
+    bool physical = true;
+    auto assemble = [&]( bool matrix, bool jacobian )
+    {
+        residual = -F;
+        physical = true;
+        double *values = J.valuePtr();
+        if (matrix)
+        {
+            std::fill(values, values + J.nonZeros(), 0.0);
+        }
+        for (int e = 0; e < ne; e++)
+        {
+            Eigen::Map<const ElementVector> Te(T.data() + e*Order);
+            ElementMatrix ke = ElementMatrix::Zero();
+            ElementMatrix je = ElementMatrix::Zero();
+            for (int g = 0; g < GaussRule::points; g++)
+            {
+                double k, dkdT;
+                curve.evaluate(N[g].dot(Te), k, dkdT);
+                if (!(k > 0.0) || !std::isfinite(k))
+                {
+                    physical = false;
+                }
+                double w = GaussRule::weight[g]*scale(e);
+                ke.noalias() += (w*k)*dN[g]*dN[g].transpose();
+                if (jacobian)
+                {
+                    je.noalias() += (w*dkdT*dN[g].dot(Te))*dN[g]*N[g].transpose();
+                }
+            }
+            residual.segment<nn>(e*Order).noalias() += ke*Te;
+            if (matrix)
+            {
+                if (jacobian)
+                {
+                    ke += je;
+                }
+                const int *outer = J.outerIndexPtr();
+                for (int j = 0; j < nn; j++)
+                {
+                    int c = e*Order + j - 1;
+                    if (c < 0 || c >= nfree)
+                    {
+                        continue;
+                    }
+                    for (int i = 0; i < nn; i++)
+                    {
+                        int r = e*Order + i - 1;
+                        if (r >= 0 && r < nfree)
+                        {
+                            values[outer[c] + r - firstRow[c]] += ke(i,j);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    VectorXd step(nfree);
+    double initialResidual = 0.0;
+    double tolerance = model.nonlinearTolerance;
+    for (int it = 0; nfree > 0; it++)
+    {
+        if (model.isCancelled())
+        {
+            fes.cancelled = true;
+            return;
+        }
+
+        NonlinearIteration record;
+        t0 = Clock::now();
+        assemble(true, newton && it > 0);
+        step = -residual.segment(1, nfree);
+        record.residual = step.norm();
+        record.assemblyTime = secondsSince(t0);
+        PROFILE_INTERVAL("nonlinear.assembly", t0);
+        if (it == 0)
+        {
+            initialResidual = record.residual;
+        }
+        if (!physical)
+        {
+            break;
+        }
+
+        t0 = Clock::now();
+        bool ok = true;
+        if constexpr (Order == 1)
+        {
+            // column c of the tridiagonal pattern holds rows c-1, c, c+1
+            const int *outer = J.outerIndexPtr();
+            const double *values = J.valuePtr();
+            for (int c = 0; c < nfree; c++)
+            {
+                int p = outer[c];
+                if (c > 0)
+                {
+                    upper(c-1) = values[p++];
+                }
+                diag(c) = values[p++];
+                if (c < nfree-1)
+                {
+                    lower(c) = values[p];
+                }
+            }
+            thomas.factorize(lower, diag, upper);
+        }
+        else if (newton)
+        {
+            lu.factorize(J);
+            ok = lu.info() == Eigen::Success;
+        }
+        else
+        {
+            ldlt.factorize(J);
+            ok = ldlt.info() == Eigen::Success;
+        }
+        record.factorizationTime = secondsSince(t0);
+        PROFILE_INTERVAL("nonlinear.factorization", t0);
+        if (!ok)
+        {
+            break;
+        }
+
+        t0 = Clock::now();
+        if constexpr (Order == 1)
+        {
+            thomas.solveInPlace(step);
+        }
+        else if (newton)
+        {
+            step = lu.solve(step);
+        }
+        else
+        {
+            step = ldlt.solve(step);
+        }
+        T.segment(1, nfree) += step;
+        record.update = step.lpNorm<Eigen::Infinity>();
+        record.solveTime = secondsSince(t0);
+        PROFILE_INTERVAL("nonlinear.substitution", t0);
+
+        fes.nonlinearHistory.push_back(record);
+        stats.assemblyTime += record.assemblyTime;
+        stats.factorizationTime += record.factorizationTime;
+        stats.solveTime += record.solveTime;
+
+        // converged once the update is down to the tolerance relative
+        // to the temperatures themselves
+        if (!(record.update > tolerance*T.lpNorm<Eigen::Infinity>()))
+        {
+            stats.converged = true;
+            break;
+        }
+        if (it + 1 >= model.maxNonlinearIterations)
+        {
+            break;
+        }
+    }
+    stats.iterations = fes.nonlinearHistory.size();
+    PROFILE_COUNTER("nonlinear.iterations", stats.iterations);
+
+    // boundary values and remaining residual at the final temperatures
+    t0 = Clock::now();
+    assemble(false, false);
+    if (nfree == 0)
+    {
+        stats.converged = true;
+    }
+    else if (initialResidual > 0.0)
+    {
+        stats.residual = residual.segment(1, nfree).norm()/initialResidual;
+    }
+    if (!physical)
+    {
+        // no solution for this conductivity, nothing to hand out
+        stats.converged = false;
+        T.setConstant( std::numeric_limits<double>::quiet_NaN() );
+        residual.setConstant( std::numeric_limits<double>::quiet_NaN() );
+    }
+    stats.postProcessTime = secondsSince(t0);
+    PROFILE_INTERVAL("nonlinear.postprocess", t0);
+
+    fes.boundaryValues = residual;
+    fes.nodalSolution = T;
+}
+
+void solveNonlinear( const FiniteElementModel &model, const VectorXd &mesh,
+                     FiniteElementSolution &fes )
+{
+    typedef void (*SolveKernel)( const FiniteElementModel &, const VectorXd &, FiniteElementSolution & );
+    static const SolveKernel kernels[2][3] = {
+        { &solveKernel<CoordType::CARTESIAN, 1>, &solveKernel<CoordType::CARTESIAN, 2>,
+          &solveKernel<CoordType::CARTESIAN, 3> },
+        { &solveKernel<CoordType::CYLINDRICAL, 1>, &solveKernel<CoordType::CYLINDRICAL, 2>,
+          &solveKernel<CoordType::CYLINDRICAL, 3> } };
+    int coord = (model.modelCoord == CoordType::CYLINDRICAL) ? 1 : 0;
+    int order = std::clamp((int)model.modelElement, 1, 3);
+    kernels[coord][order - 1](model, mesh, fes);
+}
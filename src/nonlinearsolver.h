@@ -0,0 +1,44 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef NONLINEARSOLVER_H
+#define NONLINEARSOLVER_H
+
+#include "finiteelementmodel.h"
+
+// steady solve with the conductivity curve of the model, k(T), on the
+// given SI mesh. The residual
+//   R(T) = K(T) T - F
+// is driven to zero on the free nodes, starting from the straight line
+// between the boundary values. Element matrices integrate k(T_h) at the
+// Gauss points, so any element order works; Newton adds the dk/dT term
+//   J = K(T) + integral of k'(T) T' N_i' N_j
+// which is not symmetric. The first iteration is always a Picard step.
+// The sparsity pattern and the symbolic analysis are set up once and
+// every iteration refills the same values in place;
+// linear elements stay tridiagonal and are factorized by Thomas.
+// Fills in the nodal values, the boundary values K(T)T - F, the solver
+// statistics and the iteration history; nodalXVals is left to the
+// caller. stats.iterations counts the nonlinear iterations and
+// stats.residual is the final residual relative to that of the guess.
+void solveNonlinear( const FiniteElementModel &model, const VectorXd &mesh,
+                     FiniteElementSolution &fes );
+
+#endif // NONLINEARSOLVER_H
@@ -0,0 +1,186 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "parametersweep.h"
+#include "threadpool.h"
+
+#include <cmath>
+
+ParameterSweep::ParameterSweep( const FiniteElementModel &base )
+    : baseModel(base)
+{
+    // every axis defaults to the single value of the base model
+    kValues.push_back( baseModel.get_k() );
+    qValues.push_back( baseModel.get_q() );
+    nValues.push_back( baseModel.get_n() );
+    bcAValues.push_back( baseModel.get_bc_a() );
+    bcBValues.push_back( baseModel.get_bc_b() );
+
+    threads = 0;
+    keepSolutions = false;
+    cancelled = false;
+}
+
+std::vector<double> &ParameterSweep::axis( SweepParameter which )
+{
+    switch (which)
+    {
+    case SweepParameter::K:
+        return kValues;
+    case SweepParameter::Q:
+        return qValues;
+    case SweepParameter::N:
+        return nValues;
+    case SweepParameter::BC_A:
+        return bcAValues;
+    default:
+        return bcBValues;
+    }
+}
+
+void ParameterSweep::set_values( SweepParameter which, const std::vector<double> &values )
+{
+    if (!values.empty())
+    {
+        axis(which) = values;
+    }
+}
+
+void ParameterSweep::set_range( SweepParameter which, double first, double last, int count )
+{
+    std::vector<double> values;
+    if (count <= 1)
+    {
+        values.push_back(first);
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+        {
+            values.push_back( first + (last - first)*i/(count - 1) );
+        }
+    }
+    set_values(which, values);
+}
+
+void ParameterSweep::set_threads( int new_threads )
+{
+    threads = new_threads;
+}
+
+void ParameterSweep::set_keep_solutions( bool keep )
+{
+    keepSolutions = keep;
+}
+
+void ParameterSweep::set_progress_callback( std::function<void(size_t, size_t)> callback )
+{
+    progress = callback;
+}
+
+void ParameterSweep::cancel()
+{
+    cancelled = true;
+}
+
+bool ParameterSweep::was_cancelled() const
+{
+    return cancelled;
+}
+
+size_t ParameterSweep::size() const
+{
+    return kValues.size()*qValues.size()*nValues.size()*bcAValues.size()*bcBValues.size();
+}
+
+SweepPoint ParameterSweep::get_point( size_t index ) const
+{
+    // unravel the flat index, last axis fastest
+    SweepPoint p;
+    p.bc_b = bcBValues[index % bcBValues.size()];
+    index /= bcBValues.size();
+    p.bc_a = bcAValues[index % bcAValues.size()];
+    index /= bcAValues.size();
+    p.n = (int)std::lround( nValues[index % nValues.size()] );
+    index /= nValues.size();
+    p.q = qValues[index % qValues.size()];
+    index /= qValues.size();
+    p.k = kValues[index % kValues.size()];
+    return p;
+}
+
+std::vector<SweepResult> ParameterSweep::run()
+{
+    cancelled = false;
+    size_t total = size();
+    std::vector<SweepResult> results(total);
+
+    ThreadPool pool(threads);
+    // one private model per worker, nothing mutable is shared
+    std::vector<FiniteElementModel> models( pool.size(), baseModel );
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        // lets cancel() abandon solves that are already running
+        models[i].set_cancel_check( [this] { return cancelled.load(std::memory_order_relaxed); } );
+    }
+    std::atomic<size_t> finished(0);
+
+    pool.parallelFor(total, [&](size_t index, int worker)
+    {
+        SweepResult &r = results[index];
+        r.point = get_point(index);
+        r.solved = false;
+        if (cancelled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        FiniteElementModel &model = models[worker];
+        model.set_k(r.point.k);
+        model.set_q(r.point.q);
+        model.set_n(r.point.n);
+        model.set_bc_a(r.point.bc_a);
+        model.set_bc_b(r.point.bc_b);
+        FiniteElementSolution sol = model.findNodalSolution();
+        if (sol.cancelled)
+        {
+            return;
+        }
+        model.convertToDisplayUnits(sol);
+
+        r.minTemperature = sol.nodalSolution.minCoeff();
+        r.maxTemperature = sol.nodalSolution.maxCoeff();
+        r.boundaryFluxA = sol.boundaryValues(0);
+        r.boundaryFluxB = sol.boundaryValues( sol.boundaryValues.size()-1 );
+        if (keepSolutions)
+        {
+            r.solution = std::move(sol);
+        }
+        r.solved = true;
+
+        size_t done = finished.fetch_add(1) + 1;
+        if (progress)
+        {
+            progress(done, total);
+        }
+    });
+
+    return results;
+}
@@ -0,0 +1,107 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "finiteelementmodel.h"
+
+// parameters that can be varied in a sweep
+enum class SweepParameter
+{
+    K, Q, N, BC_A, BC_B
+};
+
+// one point of the sweep grid, in the base model's unit system
+typedef struct
+{
+    double k;
+    double q;
+    int n;
+    double bc_a;
+    double bc_b;
+}
+SweepPoint;
+
+// result for one grid point in the base model's unit system; the
+// nodal vectors are only kept if asked for, the summary values are
+// always filled in
+typedef struct
+{
+    SweepPoint point;
+    bool solved; // false if the sweep was cancelled before this point
+    double minTemperature;
+    double maxTemperature;
+    double boundaryFluxA; // boundary value at x=a
+    double boundaryFluxB; // boundary value at x=b
+    FiniteElementSolution solution;
+}
+SweepResult;
+
+// runs independent solves over the Cartesian product of the given
+// parameter values on a thread pool; every worker owns a copy of the
+// base model, and results come back in grid order no matter which
+// thread finished first. Grid order has k varying slowest and bc_b
+// fastest.
+class ParameterSweep
+{
+
+public:
+    ParameterSweep( const FiniteElementModel &base );
+
+    // list of values for one parameter, unset ones use the base model
+    void set_values( SweepParameter which, const std::vector<double> &values );
+    // evenly spaced range first..last with count points
+    void set_range( SweepParameter which, double first, double last, int count );
+    void set_threads( int new_threads ); // 0 = one per core
+    void set_keep_solutions( bool keep );
+
+    // progress is called from the worker threads with the number of
+    // finished points; GUI code has to queue it onto its own thread
+    void set_progress_callback( std::function<void(size_t done, size_t total)> callback );
+    // may be called from any thread, pending points are skipped
+    void cancel();
+    bool was_cancelled() const;
+
+    size_t size() const;
+    SweepPoint get_point( size_t index ) const;
+    std::vector<SweepResult> run();
+
+private:
+    std::vector<double> &axis( SweepParameter which );
+
+    FiniteElementModel baseModel;
+    std::vector<double> kValues;
+    std::vector<double> qValues;
+    std::vector<double> nValues;
+    std::vector<double> bcAValues;
+    std::vector<double> bcBValues;
+    int threads;
+    bool keepSolutions;
+    std::function<void(size_t, size_t)> progress;
+    std::atomic<bool> cancelled;
+};
+
+#endif // PARAMETERSWEEP_H
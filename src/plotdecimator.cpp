@@ -0,0 +1,88 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "plotdecimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::vector<int> decimateMinMax( const Eigen::Ref<const Eigen::VectorXd> &x,
+                                 const Eigen::Ref<const Eigen::VectorXd> &y,
+                                 double xMin, double xMax, int columns )
+{
+    std::vector<int> kept;
+    int n = x.size();
+    if (n == 0 || columns < 1 || !(xMax > xMin))
+    {
+        return kept;
+    }
+
+    // visible nodes, widened by one on each side
+    const double *begin = x.data();
+    int first = std::lower_bound(begin, begin + n, xMin) - begin;
+    int last = std::upper_bound(begin, begin + n, xMax) - begin;
+    first = std::max(first - 1, 0);
+    last = std::min(last + 1, n);
+
+    if (last - first <= 4*columns)
+    {
+        kept.reserve(last - first);
+        for (int i = first; i < last; i++)
+        {
+            kept.push_back(i);
+        }
+        return kept;
+    }
+
+    kept.reserve(4*columns + 2);
+    double perColumn = columns/(xMax - xMin);
+    int i = first;
+    while (i < last)
+    {
+        // nodes outside the visible range each get a bin of their own
+        long column = (long)std::floor( (x(i) - xMin)*perColumn );
+        column = std::max(-1L, std::min(column, (long)columns));
+        int start = i;
+        int low = i;
+        int high = i;
+        for (i++; i < last; i++)
+        {
+            long c = (long)std::floor( (x(i) - xMin)*perColumn );
+            c = std::max(-1L, std::min(c, (long)columns));
+            if (c != column)
+            {
+                break;
+            }
+            low = (y(i) < y(low)) ? i : low;
+            high = (y(i) > y(high)) ? i : high;
+        }
+        int end = i - 1;
+
+        int picks[4] = { start, std::min(low, high), std::max(low, high), end };
+        for (int p = 0; p < 4; p++)
+        {
+            if (kept.empty() || kept.back() < picks[p])
+            {
+                kept.push_back(picks[p]);
+            }
+        }
+    }
+    return kept;
+}
@@ -0,0 +1,40 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef PLOTDECIMATOR_H
+#define PLOTDECIMATOR_H
+
+#include <vector>
+#include <eigen3/Eigen/Dense>
+
+// picks the nodes of a curve worth drawing at a given plot width. The
+// visible x range is split into one bin per pixel column and every bin
+// keeps its first, lowest, highest and last node in x order, so a line
+// through the kept nodes lights up exactly the same pixels as one
+// through all of them and no peak is lost. One node either side of the
+// visible range is kept to connect the line to the plot edges.
+// x has to be ascending; the returned indices are ascending as well,
+// and if the curve has no more nodes than 4 per column all visible
+// ones are returned.
+std::vector<int> decimateMinMax( const Eigen::Ref<const Eigen::VectorXd> &x,
+                                 const Eigen::Ref<const Eigen::VectorXd> &y,
+                                 double xMin, double xMax, int columns );
+
+#endif // PLOTDECIMATOR_H
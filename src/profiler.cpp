@@ -0,0 +1,292 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+bool Profiler::enabled()
+{
+#ifdef VARMACALC_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+// set during static initialization, so scopes opened before the first
+// instance() call still get positive timestamps
+static const Profiler::Clock::time_point processStart = Profiler::Clock::now();
+
+Profiler::Profiler()
+    : epoch(processStart)
+{
+}
+
+Profiler::ThreadBuffer &Profiler::localBuffer()
+{
+    // registered on first use and owned by the profiler, so the data
+    // outlives pool threads that have finished
+    thread_local ThreadBuffer *local = nullptr;
+    if (!local)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        buffers.push_back( std::unique_ptr<ThreadBuffer>(new ThreadBuffer) );
+        local = buffers.back().get();
+        local->thread = (int)buffers.size();
+        local->dropped = 0;
+    }
+    return *local;
+}
+
+void Profiler::record( const char *name, bool counter, int64_t start, int64_t duration,
+                       double value )
+{
+    ThreadBuffer &buffer = localBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+
+    if (buffer.events.size() < maxEvents)
+    {
+        buffer.events.push_back( { name, start, duration, value, counter } );
+    }
+    else
+    {
+        buffer.dropped++;
+    }
+
+    double sample = counter ? value : 1.0e-9*duration;
+    for (size_t i = 0; i < buffer.totals.size(); i++)
+    {
+        Totals &t = buffer.totals[i];
+        if (t.name == name)
+        {
+            t.count++;
+            t.total += sample;
+            t.min = std::min(t.min, sample);
+            t.max = std::max(t.max, sample);
+            t.last = sample;
+            return;
+        }
+    }
+    buffer.totals.push_back( { name, counter, 1, sample, sample, sample, sample } );
+}
+
+void Profiler::interval( const char *name, Clock::time_point start )
+{
+    interval(name, start, Clock::now());
+}
+
+void Profiler::interval( const char *name, Clock::time_point start, Clock::time_point end )
+{
+    int64_t begin = std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count();
+    int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    record(name, false, begin, duration, 0.0);
+}
+
+void Profiler::counter( const char *name, double value )
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+    record(name, true, now, 0, value);
+}
+
+void Profiler::reset()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        std::lock_guard<std::mutex> bufferGuard(buffers[b]->lock);
+        buffers[b]->events.clear();
+        buffers[b]->totals.clear();
+        buffers[b]->dropped = 0;
+    }
+}
+
+std::vector<ProfileSummary> Profiler::summary() const
+{
+    // literals with the same text may have different addresses in
+    // different translation units, so merge by content
+    std::vector<ProfileSummary> out;
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        std::lock_guard<std::mutex> bufferGuard(buffers[b]->lock);
+        for (const Totals &t : buffers[b]->totals)
+        {
+            size_t i = 0;
+            while (i < out.size() && (out[i].counter != t.counter || out[i].name != t.name))
+            {
+                i++;
+            }
+            if (i == out.size())
+            {
+                out.push_back( { t.name, t.counter, t.count, t.total, t.min, t.max, t.last } );
+                continue;
+            }
+            ProfileSummary &s = out[i];
+            s.count += t.count;
+            s.total += t.total;
+            s.min = std::min(s.min, t.min);
+            s.max = std::max(s.max, t.max);
+            s.last = t.last;
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const ProfileSummary &x, const ProfileSummary &y) {
+        return (x.counter != y.counter) ? !x.counter : x.total > y.total;
+    });
+    return out;
+}
+
+// names are literals from the source, but keep the output valid JSON
+static void appendJsonString( std::string &out, const char *text )
+{
+    out += '"';
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out += '\\';
+        }
+        if ((unsigned char)*c >= 0x20)
+        {
+            out += *c;
+        }
+    }
+    out += '"';
+}
+
+static void appendNumber( std::string &out, const char *format, double value )
+{
+    char text[160];
+    std::snprintf(text, sizeof(text), format, value);
+    out += text;
+}
+
+std::string Profiler::summaryJson() const
+{
+    std::vector<ProfileSummary> all = summary();
+    std::string out = "{\n  \"scopes\": [";
+    bool first = true;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+        {
+            out += "\n  ],\n  \"counters\": [";
+            first = true;
+        }
+        for (const ProfileSummary &s : all)
+        {
+            if (s.counter != (pass == 1))
+            {
+                continue;
+            }
+            out += first ? "\n    {" : ",\n    {";
+            first = false;
+            out += "\"name\": ";
+            appendJsonString(out, s.name.c_str());
+            appendNumber(out, ", \"count\": %.0f", (double)s.count);
+            appendNumber(out, ", \"total\": %.9g", s.total);
+            appendNumber(out, ", \"mean\": %.9g", s.total/s.count);
+            appendNumber(out, ", \"min\": %.9g", s.min);
+            appendNumber(out, ", \"max\": %.9g", s.max);
+            if (s.counter)
+            {
+                appendNumber(out, ", \"last\": %.9g", s.last);
+            }
+            out += "}";
+        }
+    }
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+std::string Profiler::chromeTrace() const
+{
+    // complete events ("X") for intervals and counter events ("C"),
+    // timestamps in microseconds
+    std::string out = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t b = 0; b < buffers.size(); b++)
+    {
+        const ThreadBuffer &buffer = *buffers[b];
+        std::lock_guard<std::mutex> bufferGuard(buffers[b]->lock);
+        for (const Event &e : buffer.events)
+        {
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += "{\"name\": ";
+            appendJsonString(out, e.name);
+            appendNumber(out, ", \"pid\": 1, \"tid\": %.0f", (double)buffer.thread);
+            appendNumber(out, ", \"ts\": %.3f", 1.0e-3*e.start);
+            if (!e.counter)
+            {
+                appendNumber(out, ", \"ph\": \"X\", \"dur\": %.3f}", 1.0e-3*e.duration);
+            }
+            else
+            {
+                appendNumber(out, ", \"ph\": \"C\", \"args\": {\"value\": %.9g}}", e.value);
+            }
+        }
+        if (buffer.dropped > 0)
+        {
+            out += first ? "\n" : ",\n";
+            first = false;
+            appendNumber(out, "{\"name\": \"dropped events\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"ts\": 0, \"tid\": %.0f", (double)buffer.thread);
+            appendNumber(out, ", \"args\": {\"count\": %.0f}}", (double)buffer.dropped);
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+static bool writeText( const std::string &fileName, const std::string &text, std::string &error )
+{
+    FILE *file = std::fopen(fileName.c_str(), "w");
+    if (!file)
+    {
+        error = "cannot open " + fileName + " for writing";
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        error = "cannot write " + fileName;
+    }
+    return ok;
+}
+
+bool Profiler::writeSummaryJson( const std::string &fileName, std::string &error ) const
+{
+    return writeText(fileName, summaryJson(), error);
+}
+
+bool Profiler::writeChromeTrace( const std::string &fileName, std::string &error ) const
+{
+    return writeText(fileName, chromeTrace(), error);
+}
@@ -0,0 +1,153 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// hot path instrumentation, only compiled in with VARMACALC_PROFILING
+// (cmake -DENABLE_PROFILING=ON); otherwise the macros expand to nothing
+// and no clock is read. Names must be string literals.
+//   PROFILE_SCOPE("model.solve");            times the enclosing block
+//   PROFILE_INTERVAL("model.assembly", t0);  from a steady_clock t0 to now
+//   PROFILE_COUNTER("model.unknowns", n);    adds a sample to a counter
+#ifdef VARMACALC_PROFILING
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_INTERVAL(name, start) Profiler::instance().interval(name, start)
+#define PROFILE_COUNTER(name, value) Profiler::instance().counter(name, value)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_INTERVAL(name, start) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#endif
+
+// totals for one timer or counter name over every thread
+typedef struct
+{
+    std::string name;
+    bool counter; // value samples instead of times
+    long count; // intervals or samples recorded
+    double total; // seconds, or the sum of the samples
+    double min;
+    double max;
+    double last; // most recent sample, counters only
+}
+ProfileSummary;
+
+// collects intervals and counter samples from any thread. Every thread
+// appends to its own buffer, so recording only takes that buffer's
+// uncontended lock; the totals are exact, the event list for the trace
+// keeps the first maxEvents entries per thread
+class Profiler
+{
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static Profiler &instance();
+    static bool enabled(); // built with VARMACALC_PROFILING
+
+    void interval( const char *name, Clock::time_point start );
+    void interval( const char *name, Clock::time_point start, Clock::time_point end );
+    void counter( const char *name, double value );
+    void reset();
+
+    // timers first, each group by decreasing total
+    std::vector<ProfileSummary> summary() const;
+    // {"scopes":[...],"counters":[...]} with times in seconds
+    std::string summaryJson() const;
+    // Chrome trace event format, opens in chrome://tracing or Perfetto
+    std::string chromeTrace() const;
+    bool writeSummaryJson( const std::string &fileName, std::string &error ) const;
+    bool writeChromeTrace( const std::string &fileName, std::string &error ) const;
+
+    static const size_t maxEvents = 1 << 18;
+
+private:
+    typedef struct
+    {
+        const char *name;
+        int64_t start; // ns since the profiler epoch
+        int64_t duration; // ns, 0 for counter samples
+        double value; // counter samples only
+        bool counter;
+    }
+    Event;
+
+    typedef struct
+    {
+        const char *name;
+        bool counter;
+        long count;
+        double total;
+        double min;
+        double max;
+        double last;
+    }
+    Totals;
+
+    struct ThreadBuffer
+    {
+        std::mutex lock;
+        int thread;
+        std::vector<Event> events;
+        std::vector<Totals> totals; // few names, searched linearly
+        size_t dropped;
+    };
+
+    Profiler();
+    ThreadBuffer &localBuffer();
+    void record( const char *name, bool counter, int64_t start, int64_t duration, double value );
+
+    Clock::time_point epoch;
+    mutable std::mutex lock; // guards the buffer list only
+    std::vector< std::unique_ptr<ThreadBuffer> > buffers;
+};
+
+// records the lifetime of the object as one interval
+class ProfileScope
+{
+
+public:
+    explicit ProfileScope( const char *scopeName )
+        : name(scopeName), start(Profiler::Clock::now())
+    {
+    }
+    ~ProfileScope()
+    {
+        Profiler::instance().interval(name, start);
+    }
+    ProfileScope( const ProfileScope & ) = delete;
+    ProfileScope &operator=( const ProfileScope & ) = delete;
+
+private:
+    const char *name;
+    Profiler::Clock::time_point start;
+};
+
+#endif // PROFILER_H
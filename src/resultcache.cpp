@@ -0,0 +1,432 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "resultcache.h"
+#include "solutionfile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// after the arrays of a cache file, native byte order:
+//   0   char[8]  magic "VMCCACHE"
+//   8   uint64   key length
+//   16  uint64   sizeof(SolverStatistics)
+//   24  uint64   nonlinear history entries
+//   32  uint64   sizeof(NonlinearIteration)
+//   40  int64    refinementPasses
+//   48  double   estimatedError
+//   56  uint64   length of each sensitivity, k, q, bc_a, bc_b
+//   88  ...      key, statistics, history, sensitivities
+// the struct sizes guard against files from a build with other layouts
+static const char TRAILER_MAGIC[8] = { 'V', 'M', 'C', 'C', 'A', 'C', 'H', 'E' };
+static const size_t TRAILER_SIZE = 88;
+
+static VectorXd SolutionSensitivities::* const SENSITIVITIES[4] = {
+    &SolutionSensitivities::k, &SolutionSensitivities::q,
+    &SolutionSensitivities::bc_a, &SolutionSensitivities::bc_b };
+
+static size_t solutionBytes( const std::string &key, const FiniteElementSolution &sol )
+{
+    return sizeof(FiniteElementSolution) + key.size()
+        + sizeof(double)*(sol.nodalXVals.size() + sol.nodalSolution.size() + sol.boundaryValues.size())
+        + sizeof(NonlinearIteration)*sol.nonlinearHistory.size()
+        + sizeof(double)*(sol.sensitivities.k.size() + sol.sensitivities.q.size()
+                          + sol.sensitivities.bc_a.size() + sol.sensitivities.bc_b.size());
+}
+
+// FNV-1a
+static uint64_t keyHash( const std::string &key )
+{
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        h = (h ^ (unsigned char)key[i])*1099511628211ull;
+    }
+    return h;
+}
+
+static int64_t fileTime( const fs::path &path )
+{
+    std::error_code ec;
+    return fs::last_write_time(path, ec).time_since_epoch().count();
+}
+
+ResultCache::ResultCache()
+{
+    memoryBudget = 64u << 20;
+    diskBudget = 1u << 30;
+    bytes = 0;
+    diskBytes = 0;
+    counters = ResultCacheStats {};
+}
+
+void ResultCache::set_memory_budget( size_t new_bytes )
+{
+    std::lock_guard<std::mutex> guard(lock);
+    memoryBudget = new_bytes;
+    while (bytes > memoryBudget && !recent.empty())
+    {
+        bytes -= recent.back().bytes;
+        index.erase(recent.back().key);
+        recent.pop_back();
+        counters.evictions++;
+    }
+}
+
+void ResultCache::set_disk_budget( size_t new_bytes )
+{
+    std::lock_guard<std::mutex> guard(lock);
+    diskBudget = new_bytes;
+    evictFiles();
+}
+
+bool ResultCache::set_directory( const std::string &new_directory, std::string &error )
+{
+    std::lock_guard<std::mutex> guard(lock);
+    directory.clear();
+    diskIndex.clear();
+    diskBytes = 0;
+    if (new_directory.empty())
+    {
+        return true;
+    }
+
+    std::error_code ec;
+    fs::create_directories(new_directory, ec);
+    if (ec || !fs::is_directory(new_directory, ec))
+    {
+        error = "cannot create cache directory " + new_directory;
+        return false;
+    }
+    directory = new_directory;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (it->path().extension() != ".vmcs" || !it->is_regular_file(ec))
+        {
+            continue;
+        }
+        DiskEntry entry;
+        entry.bytes = it->file_size(ec);
+        entry.lastUse = fileTime(it->path());
+        diskIndex[it->path().filename().string()] = entry;
+        diskBytes += entry.bytes;
+    }
+    evictFiles();
+    return true;
+}
+
+std::shared_ptr<const FiniteElementSolution> ResultCache::find( const FiniteElementModel &model )
+{
+    std::string key = model.solutionKey();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = index.find(key);
+        if (found != index.end())
+        {
+            recent.splice(recent.begin(), recent, found->second);
+            counters.hits++;
+            return found->second->sol;
+        }
+        // files of other processes may not be indexed yet, so the
+        // directory is always looked at
+        if (directory.empty())
+        {
+            counters.misses++;
+            return nullptr;
+        }
+    }
+
+    // the file is read without holding the lock
+    std::shared_ptr<const FiniteElementSolution> sol = readFile(key);
+    std::lock_guard<std::mutex> guard(lock);
+    if (!sol)
+    {
+        counters.misses++;
+        return nullptr;
+    }
+    counters.hits++;
+    counters.diskHits++;
+    remember(key, sol);
+    return sol;
+}
+
+void ResultCache::insert( const FiniteElementModel &model,
+                          std::shared_ptr<const FiniteElementSolution> sol )
+{
+    if (!sol || sol->cancelled)
+    {
+        return;
+    }
+    std::string key = model.solutionKey();
+    bool toDisk;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.inserts++;
+        remember(key, sol);
+        toDisk = !directory.empty() && diskIndex.count(fileName(key)) == 0;
+    }
+    if (toDisk)
+    {
+        writeFile(key, *sol, model);
+    }
+}
+
+void ResultCache::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    recent.clear();
+    index.clear();
+    bytes = 0;
+}
+
+ResultCacheStats ResultCache::stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    ResultCacheStats s = counters;
+    s.entries = recent.size();
+    s.bytes = bytes;
+    s.diskEntries = diskIndex.size();
+    s.diskBytes = diskBytes;
+    return s;
+}
+
+void ResultCache::remember( const std::string &key, std::shared_ptr<const FiniteElementSolution> sol )
+{
+    // with the lock held
+    size_t size = solutionBytes(key, *sol);
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        bytes -= found->second->bytes;
+        recent.erase(found->second);
+        index.erase(found);
+    }
+    if (size > memoryBudget)
+    {
+        return; // would push out everything else, the disk copy has to do
+    }
+    Entry entry;
+    entry.key = key;
+    entry.sol = std::move(sol);
+    entry.bytes = size;
+    recent.push_front(std::move(entry));
+    index[key] = recent.begin();
+    bytes += size;
+    while (bytes > memoryBudget)
+    {
+        bytes -= recent.back().bytes;
+        index.erase(recent.back().key);
+        recent.pop_back();
+        counters.evictions++;
+    }
+}
+
+std::string ResultCache::fileName( const std::string &key ) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.vmcs", (unsigned long long)keyHash(key));
+    return name;
+}
+
+std::shared_ptr<FiniteElementSolution> ResultCache::readFile( const std::string &key )
+{
+    fs::path path = fs::path(directory) / fileName(key);
+    SolutionFile file;
+    std::string error;
+    if (!file.open(path.string(), error) || file.info().units != UnitSystem::SI)
+    {
+        return nullptr;
+    }
+
+    const unsigned char *t = file.trailer();
+    size_t available = file.trailerSize();
+    uint64_t keyLength, statsSize, historyCount, historySize;
+    uint64_t sensitivityLength[4];
+    uint64_t sensitivityTotal = 0;
+    int64_t passes;
+    double estimate;
+    if (available < TRAILER_SIZE || std::memcmp(t, TRAILER_MAGIC, 8) != 0)
+    {
+        return nullptr;
+    }
+    std::memcpy(&keyLength, t + 8, 8);
+    std::memcpy(&statsSize, t + 16, 8);
+    std::memcpy(&historyCount, t + 24, 8);
+    std::memcpy(&historySize, t + 32, 8);
+    std::memcpy(&passes, t + 40, 8);
+    std::memcpy(&estimate, t + 48, 8);
+    for (int i = 0; i < 4; i++)
+    {
+        std::memcpy(&sensitivityLength[i], t + 56 + 8*i, 8);
+        sensitivityLength[i] = std::min<uint64_t>(sensitivityLength[i], available/sizeof(double));
+        sensitivityTotal += sensitivityLength[i];
+    }
+    // a different key is a hash collision, a different layout another build
+    if (keyLength != key.size() || statsSize != sizeof(SolverStatistics)
+        || historySize != sizeof(NonlinearIteration)
+        || historyCount > available/sizeof(NonlinearIteration)
+        || available != TRAILER_SIZE + keyLength + statsSize + historyCount*historySize
+                        + sensitivityTotal*sizeof(double)
+        || std::memcmp(t + TRAILER_SIZE, key.data(), keyLength) != 0)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<FiniteElementSolution> sol =
+        std::make_shared<FiniteElementSolution>( file.toSolution() );
+    const unsigned char *rest = t + TRAILER_SIZE + keyLength;
+    std::memcpy(&sol->stats, rest, sizeof(SolverStatistics));
+    sol->nonlinearHistory.resize(historyCount);
+    if (historyCount > 0)
+    {
+        std::memcpy(sol->nonlinearHistory.data(), rest + statsSize, historyCount*historySize);
+    }
+    rest += statsSize + historyCount*historySize;
+    for (int i = 0; i < 4; i++)
+    {
+        VectorXd &v = sol->sensitivities.*SENSITIVITIES[i];
+        v.resize(sensitivityLength[i]);
+        std::memcpy(v.data(), rest, sensitivityLength[i]*sizeof(double));
+        rest += sensitivityLength[i]*sizeof(double);
+    }
+    sol->refinementPasses = (int)passes;
+    sol->estimatedError = estimate;
+    file.close();
+
+    // a hit makes the file the newest one for eviction
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = diskIndex.find(fileName(key));
+    if (found == diskIndex.end())
+    {
+        DiskEntry entry;
+        entry.bytes = fs::file_size(path, ec);
+        found = diskIndex.insert(std::make_pair(fileName(key), entry)).first;
+        diskBytes += entry.bytes;
+    }
+    found->second.lastUse = fileTime(path);
+    return sol;
+}
+
+void ResultCache::writeFile( const std::string &key, const FiniteElementSolution &sol,
+                             const FiniteElementModel &model )
+{
+    std::string name = fileName(key);
+    fs::path path = fs::path(directory) / name;
+    // written under a name of its own and renamed into place, so other
+    // threads and processes never see a partial file
+    fs::path part = path;
+    part += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".part";
+
+    SolutionFileInfo info;
+    info.units = UnitSystem::SI;
+    info.coord = model.modelCoord;
+    info.element = model.modelElement;
+    std::string error;
+    if (!writeSolutionBinary(part.string(), sol, info, error))
+    {
+        return;
+    }
+
+    unsigned char trailer[TRAILER_SIZE] = {};
+    uint64_t keyLength = key.size();
+    uint64_t statsSize = sizeof(SolverStatistics);
+    uint64_t historyCount = sol.nonlinearHistory.size();
+    uint64_t historySize = sizeof(NonlinearIteration);
+    int64_t passes = sol.refinementPasses;
+    std::memcpy(trailer, TRAILER_MAGIC, 8);
+    std::memcpy(trailer + 8, &keyLength, 8);
+    std::memcpy(trailer + 16, &statsSize, 8);
+    std::memcpy(trailer + 24, &historyCount, 8);
+    std::memcpy(trailer + 32, &historySize, 8);
+    std::memcpy(trailer + 40, &passes, 8);
+    std::memcpy(trailer + 48, &sol.estimatedError, 8);
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t length = (sol.sensitivities.*SENSITIVITIES[i]).size();
+        std::memcpy(trailer + 56 + 8*i, &length, 8);
+    }
+
+    FILE *file = std::fopen(part.string().c_str(), "ab");
+    bool ok = file != nullptr
+        && std::fwrite(trailer, 1, TRAILER_SIZE, file) == TRAILER_SIZE
+        && std::fwrite(key.data(), 1, key.size(), file) == key.size()
+        && std::fwrite(&sol.stats, sizeof(SolverStatistics), 1, file) == 1
+        && std::fwrite(sol.nonlinearHistory.data(), sizeof(NonlinearIteration), historyCount, file)
+            == historyCount;
+    for (int i = 0; i < 4 && ok; i++)
+    {
+        const VectorXd &v = sol.sensitivities.*SENSITIVITIES[i];
+        ok = std::fwrite(v.data(), sizeof(double), v.size(), file) == (size_t)v.size();
+    }
+    ok = (file != nullptr && std::fclose(file) == 0) && ok;
+    std::error_code ec;
+    if (ok)
+    {
+        fs::rename(part, path, ec);
+    }
+    if (!ok || ec)
+    {
+        fs::remove(part, ec);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    DiskEntry entry;
+    entry.bytes = fs::file_size(path, ec);
+    entry.lastUse = fileTime(path);
+    auto found = diskIndex.find(name);
+    if (found != diskIndex.end())
+    {
+        diskBytes -= found->second.bytes;
+    }
+    diskIndex[name] = entry;
+    diskBytes += entry.bytes;
+    evictFiles();
+}
+
+void ResultCache::evictFiles()
+{
+    // with the lock held; the oldest file goes first, a linear search
+    // is fine for the few thousand files a budget holds
+    while (diskBytes > diskBudget && !diskIndex.empty())
+    {
+        auto oldest = diskIndex.begin();
+        for (auto it = diskIndex.begin(); it != diskIndex.end(); ++it)
+        {
+            if (it->second.lastUse < oldest->second.lastUse)
+            {
+                oldest = it;
+            }
+        }
+        std::error_code ec;
+        fs::remove(fs::path(directory) / oldest->first, ec);
+        diskBytes -= oldest->second.bytes;
+        diskIndex.erase(oldest);
+    }
+}
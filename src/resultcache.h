@@ -0,0 +1,117 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "finiteelementmodel.h"
+
+typedef struct
+{
+    uint64_t hits; // memory and disk together
+    uint64_t diskHits; // found on disk, not in memory
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions; // from memory
+    size_t entries; // in memory
+    size_t bytes; // in memory
+    size_t diskEntries;
+    size_t diskBytes;
+}
+ResultCacheStats;
+
+// solved SI solutions by FiniteElementModel::solutionKey(), so a case
+// that was solved before, in any unit system, comes back without
+// solving. The most recently used solutions are kept in memory up to a
+// byte budget. With a directory set, every solution is also written
+// there as a .vmcs result file, named by a 64 bit hash of the key,
+// with the full key and the solver statistics after the arrays. A
+// lookup that misses in memory maps that file, checks the key and
+// reads the solution back, also in a later session. The disk tier has
+// its own budget and drops the files least recently used, by
+// modification time, which every hit updates. Safe to use from
+// several threads.
+class ResultCache
+{
+
+public:
+    ResultCache();
+
+    void set_memory_budget( size_t bytes ); // 64 MiB by default
+    void set_disk_budget( size_t bytes ); // 1 GiB by default
+    // creates the directory if needed and indexes the files already
+    // there; an empty name turns the disk tier off
+    bool set_directory( const std::string &directory, std::string &error );
+
+    // the stored SI solution for the model's inputs, or nothing
+    std::shared_ptr<const FiniteElementSolution> find( const FiniteElementModel &model );
+    // an SI solution of the model, not a cancelled one
+    void insert( const FiniteElementModel &model, std::shared_ptr<const FiniteElementSolution> sol );
+    void clear(); // memory only, the files stay
+
+    ResultCacheStats stats();
+
+private:
+    typedef struct
+    {
+        std::string key;
+        std::shared_ptr<const FiniteElementSolution> sol;
+        size_t bytes;
+    }
+    Entry;
+
+    typedef struct
+    {
+        size_t bytes;
+        int64_t lastUse; // file time, larger is newer
+    }
+    DiskEntry;
+
+    void remember( const std::string &key, std::shared_ptr<const FiniteElementSolution> sol );
+    std::string fileName( const std::string &key ) const;
+    std::shared_ptr<FiniteElementSolution> readFile( const std::string &key );
+    void writeFile( const std::string &key, const FiniteElementSolution &sol,
+                    const FiniteElementModel &model );
+    void evictFiles();
+
+    std::mutex lock;
+    size_t memoryBudget;
+    size_t diskBudget;
+    std::string directory;
+
+    std::list<Entry> recent; // most recently used first
+    std::unordered_map< std::string, std::list<Entry>::iterator > index;
+    size_t bytes;
+    std::map<std::string, DiskEntry> diskIndex; // by file name
+    size_t diskBytes;
+
+    ResultCacheStats counters;
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,169 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "rodbatch.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+RodBatchSolver::RodBatchSolver()
+{
+    n = 0;
+    coord = CoordType::CARTESIAN;
+    threads = 1;
+    set_n(11);
+}
+
+void RodBatchSolver::set_n( int new_n )
+{
+    if (new_n < 2 || new_n == n)
+    {
+        return;
+    }
+    n = new_n;
+
+    // Thomas pivots of tridiag(-1, 2, -1): d0 = 2, dj = 2 - 1/d(j-1),
+    // which is (j+2)/(j+1)
+    int m = n - 2;
+    invPivots.resize(m);
+    for (int j = 0; j < m; j++)
+    {
+        invPivots(j) = double(j + 1)/double(j + 2);
+    }
+}
+
+void RodBatchSolver::set_coord( CoordType new_coord )
+{
+    coord = new_coord;
+}
+
+void RodBatchSolver::set_threads( int new_threads )
+{
+    threads = new_threads;
+}
+
+int RodBatchSolver::get_n() const
+{
+    return n;
+}
+
+int RodBatchSolver::size() const
+{
+    return temperatures.rows();
+}
+
+const Eigen::ArrayXXd &RodBatchSolver::get_temperatures() const
+{
+    return temperatures;
+}
+
+const Eigen::ArrayXXd &RodBatchSolver::get_boundary_values() const
+{
+    return boundaryValues;
+}
+
+void RodBatchSolver::solve( const RodBatchInputs &inputs )
+{
+    PROFILE_SCOPE("rodbatch.solve");
+    int count = inputs.a.size();
+    temperatures.resize(count, n);
+    boundaryValues.resize(count, 2);
+    start = inputs.a;
+    step = (inputs.b - inputs.a)/(n - 1);
+
+    int blocks = (count + laneBlock - 1)/laneBlock;
+    if (threads == 1 || blocks < 2)
+    {
+        for (int block = 0; block < blocks; block++)
+        {
+            solveBlock(inputs, block*laneBlock, std::min(laneBlock, count - block*laneBlock));
+        }
+    }
+    else
+    {
+        ThreadPool pool(threads);
+        pool.parallelFor(blocks, [&](size_t block, int)
+        {
+            int first = (int)block*laneBlock;
+            solveBlock(inputs, first, std::min(laneBlock, count - first));
+        });
+    }
+    PROFILE_COUNTER("rodbatch.nodes", (double)count*n);
+}
+
+void RodBatchSolver::solveBlock( const RodBatchInputs &inputs, int first, int count )
+{
+    typedef Eigen::Array<double, Eigen::Dynamic, 1, 0, laneBlock, 1> Lanes;
+
+    // element factor c and load s = q*h of every rod, the sweeps work
+    // on the load scaled by 1/c
+    Lanes h = step.segment(first, count);
+    Lanes k = inputs.k.segment(first, count);
+    Lanes c = (coord == CoordType::CYLINDRICAL) ? Lanes(k/h + 0.5*k) : Lanes(k/h);
+    Lanes s = inputs.q.segment(first, count)*h;
+    Lanes g = s/c;
+    Lanes bcA = inputs.bc_a.segment(first, count);
+    Lanes bcB = inputs.bc_b.segment(first, count);
+
+    auto node = [&]( int i ) { return temperatures.col(i).segment(first, count); };
+    node(0) = bcA;
+    node(n-1) = bcB;
+
+    // forward sweep into the interior columns, then back substitution
+    // in place; unknown j is node j+1
+    int m = n - 2;
+    if (m > 0)
+    {
+        node(1) = g + bcA;
+        for (int j = 1; j < m; j++)
+        {
+            node(j+1) = g + invPivots(j-1)*node(j);
+        }
+        node(m) += bcB;
+        node(m) *= invPivots(m-1);
+        for (int j = m - 2; j >= 0; j--)
+        {
+            node(j+1) = invPivots(j)*(node(j+1) + node(j+2));
+        }
+    }
+
+    // K*T - F at the two ends
+    boundaryValues.col(0).segment(first, count) = c*(bcA - node(1)) - 0.5*s;
+    boundaryValues.col(1).segment(first, count) = c*(bcB - node(n-2)) - 0.5*s;
+}
+
+FiniteElementSolution RodBatchSolver::solution( int rod ) const
+{
+    FiniteElementSolution fes;
+    fes.nodalSolution = temperatures.row(rod).transpose();
+    fes.nodalXVals = VectorXd::LinSpaced(n, start(rod), start(rod) + (n - 1)*step(rod));
+    fes.boundaryValues = VectorXd::Zero(n);
+    fes.boundaryValues(0) = boundaryValues(rod, 0);
+    fes.boundaryValues(n-1) = boundaryValues(rod, 1);
+    fes.stats = SolverStatistics {};
+    fes.stats.solver = SolverType::BANDED;
+    fes.stats.unknowns = n - 2;
+    fes.stats.converged = true;
+    fes.cancelled = false;
+    fes.refinementPasses = 0;
+    fes.estimatedError = 0.0;
+    return fes;
+}
@@ -0,0 +1,93 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef RODBATCH_H
+#define RODBATCH_H
+
+#include <eigen3/Eigen/Dense>
+
+#include "finiteelementmodel.h"
+
+// inputs of a batch of rods in SI, one entry per rod in every array
+typedef struct
+{
+    Eigen::ArrayXd a; // m
+    Eigen::ArrayXd b; // m
+    Eigen::ArrayXd bc_a; // K
+    Eigen::ArrayXd bc_b; // K
+    Eigen::ArrayXd k; // W/mK
+    Eigen::ArrayXd q; // W/m^3
+}
+RodBatchInputs;
+
+// steady solves of many independent short rods with the same node
+// count, linear elements on a uniform mesh, each rod with its own
+// interval, boundary values, k and q. Group rods by n and use one
+// solver per group.
+//
+// With constant k every element has the same factor c = k/h (+ k/2 in
+// cylindrical coordinates), so the reduced matrix of every rod is c
+// times tridiag(-1, 2, -1). Its Thomas pivots depend on n only and are
+// computed once; a rod is then solved by one forward and one backward
+// sweep of its load, scaled by 1/c. The results are stored node major,
+// column i holding node i of every rod, so each sweep step is a
+// contiguous array operation across rods that Eigen vectorizes with
+// whatever SIMD the build targets (see ENABLE_NATIVE_ARCH), plain
+// scalar code otherwise. Rods are swept in blocks small enough to stay
+// in cache, and blocks are spread over threads if asked for.
+class RodBatchSolver
+{
+
+public:
+    RodBatchSolver();
+
+    void set_n( int new_n ); // nodes per rod, at least 2
+    void set_coord( CoordType new_coord );
+    void set_threads( int new_threads ); // 1 by default, 0 = one per core
+    int get_n() const;
+
+    // solves every rod in inputs, replacing earlier results
+    void solve( const RodBatchInputs &inputs );
+
+    int size() const; // rods in the last solve
+    // rods x nodes, SI
+    const Eigen::ArrayXXd &get_temperatures() const;
+    // K*T - F at x=a and at x=b, rods x 2, SI
+    const Eigen::ArrayXXd &get_boundary_values() const;
+    // one rod of the last solve as a regular solution, SI
+    FiniteElementSolution solution( int rod ) const;
+
+    static const int laneBlock = 64; // rods per sweep
+
+private:
+    void solveBlock( const RodBatchInputs &inputs, int first, int count );
+
+    int n;
+    CoordType coord;
+    int threads;
+    VectorXd invPivots; // of tridiag(-1, 2, -1) with n-2 unknowns
+
+    Eigen::ArrayXXd temperatures;
+    Eigen::ArrayXXd boundaryValues;
+    Eigen::ArrayXd start; // a of every rod, for the x values
+    Eigen::ArrayXd step; // element length of every rod
+};
+
+#endif // RODBATCH_H
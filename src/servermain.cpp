@@ -0,0 +1,403 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+// local solve service: serves solve requests on a Unix domain socket
+// until SIGINT or SIGTERM, see solveserver.h and solveprotocol.h
+//
+// with --connect it is instead a client of a running server: it reads
+// cases in the batch tool's format, sends them all at once, pipelined
+// over one or more connections, and writes the same CSV as
+// varmacalc-batch together with the round trip times on stderr
+
+#include "caseparser.h"
+#include "solveprotocol.h"
+#include "solveserver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static void printUsage( const char *prog )
+{
+    std::cerr << "usage: " << prog << " --socket path [--threads n] [--max-batch n] [--max-queue n]\n"
+              << "       [--stats-every seconds]\n"
+              << "       " << prog << " --connect path [-i input] [-o output] [--binary]\n"
+              << "       [--clients n] [--stats]\n"
+              << "  --socket     serve on path until SIGINT or SIGTERM\n"
+              << "  --threads    solver threads, default one per core\n"
+              << "  --max-batch  requests solved together at most (256)\n"
+              << "  --max-queue  waiting requests before new ones are refused (65536)\n"
+              << "  --connect    send the cases in input to the server on path and write\n"
+              << "               case,node,x,T,boundary rows as CSV to output\n"
+              << "  --binary     binary requests and replies instead of JSON\n"
+              << "  --clients    connections the cases are spread over (1)\n"
+              << "  --stats      print the server statistics as JSON and exit\n";
+}
+
+static void printStats( SolveServer &server )
+{
+    SolveServerStats s = server.stats();
+    std::fprintf(stderr, "queue %zu, in flight %zu, %llu done, %llu failed, %llu refused, "
+                 "mean batch %.1f, latency p50 %.3f p90 %.3f p99 %.3f ms\n",
+                 s.queueDepth, s.inFlight, (unsigned long long)s.completed,
+                 (unsigned long long)s.failed, (unsigned long long)s.rejected, s.meanBatch,
+                 1.0e3*s.latencyP50, 1.0e3*s.latencyP90, 1.0e3*s.latencyP99);
+}
+
+static int runServer( const char *path, int threads, int maxBatch, int maxQueue, double statsEvery )
+{
+    // the signals are taken with sigwait below; block them before any
+    // thread starts so none of the server threads gets them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    SolveServer server;
+    server.set_socket_path(path);
+    server.set_threads(threads);
+    server.set_max_batch(maxBatch);
+    server.set_max_queue(maxQueue);
+    std::string error;
+    if (!server.start(error))
+    {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    std::cerr << "serving on " << path << "\n";
+
+    while (true)
+    {
+        if (statsEvery <= 0.0)
+        {
+            int signal = 0;
+            sigwait(&signals, &signal);
+            break;
+        }
+        struct timespec wait;
+        wait.tv_sec = (time_t)statsEvery;
+        wait.tv_nsec = (long)((statsEvery - wait.tv_sec)*1.0e9);
+        if (sigtimedwait(&signals, nullptr, &wait) >= 0)
+        {
+            break;
+        }
+        printStats(server);
+    }
+
+    server.stop();
+    printStats(server);
+    return 0;
+}
+
+static int connectTo( const char *path )
+{
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && ::connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static int runStats( const char *path )
+{
+    int fd = connectTo(path);
+    std::string payload;
+    if (fd < 0 || !SolveProtocol::writeFrame(fd, "{\"command\": \"stats\"}")
+        || !SolveProtocol::readFrame(fd, payload, SolveProtocol::maxRequest))
+    {
+        std::cerr << "no server answering on " << path << "\n";
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return 1;
+    }
+    ::close(fd);
+    std::printf("%s\n", payload.c_str());
+    return 0;
+}
+
+static int runClient( const char *path, const char *inputName, const char *outputName,
+                      bool binary, int clients )
+{
+    std::ifstream inputFile;
+    std::istream *in = &std::cin;
+    if (inputName != nullptr && std::strcmp(inputName, "-") != 0)
+    {
+        inputFile.open(inputName);
+        if (!inputFile)
+        {
+            std::cerr << "cannot open input file " << inputName << "\n";
+            return 1;
+        }
+        in = &inputFile;
+    }
+
+    // request payloads in case order; the id is the case number
+    int status = 0;
+    std::vector<std::string> requests;
+    std::string line;
+    while (std::getline(*in, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+        uint64_t id = requests.size() + 1;
+        std::vector< std::pair<std::string, std::string> > pairs;
+        std::string error;
+        if (!splitCase(line, pairs, error))
+        {
+            // sent anyway, so the server reports it like any bad case
+            pairs.assign(1, std::make_pair(line, std::string()));
+        }
+        requests.push_back(binary ? SolveProtocol::encodeBinaryRequest(id, line.substr(0, line.find('#')))
+                           : SolveProtocol::encodeJsonRequest(id, ReplyFormat::JSON, pairs));
+    }
+
+    clients = std::max(1, std::min<int>(clients, std::max<size_t>(requests.size(), 1)));
+    std::vector<int> fds(clients, -1);
+    for (int c = 0; c < clients; c++)
+    {
+        fds[c] = connectTo(path);
+        if (fds[c] < 0)
+        {
+            std::cerr << "no server answering on " << path << "\n";
+            for (int d = 0; d < c; d++)
+            {
+                ::close(fds[d]);
+            }
+            return 1;
+        }
+    }
+
+    // case i goes over connection i % clients; every connection has a
+    // sender and a receiver so neither side blocks on a full socket
+    std::vector<SolveReply> replies(requests.size());
+    std::vector<Clock::time_point> sent(requests.size());
+    std::vector<double> roundTrip(requests.size(), 0.0);
+    std::vector<char> answered(requests.size(), 0);
+    Clock::time_point t0 = Clock::now();
+    std::vector<std::thread> workers;
+    for (int c = 0; c < clients; c++)
+    {
+        workers.push_back(std::thread([&, c]()
+        {
+            std::thread sender([&, c]()
+            {
+                for (size_t i = c; i < requests.size(); i += clients)
+                {
+                    sent[i] = Clock::now();
+                    if (!SolveProtocol::writeFrame(fds[c], requests[i]))
+                    {
+                        break;
+                    }
+                }
+            });
+            size_t expected = (requests.size() - c + clients - 1)/clients;
+            std::string payload;
+            for (size_t got = 0; got < expected; got++)
+            {
+                SolveReply reply;
+                std::string error;
+                if (!SolveProtocol::readFrame(fds[c], payload, UINT32_MAX)
+                    || !SolveProtocol::decodeReply(payload, reply, error)
+                    || reply.id < 1 || reply.id > requests.size())
+                {
+                    break;
+                }
+                size_t i = reply.id - 1;
+                roundTrip[i] = std::chrono::duration<double>(Clock::now() - sent[i]).count();
+                replies[i] = reply;
+                answered[i] = 1;
+            }
+            sender.join();
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++)
+    {
+        workers[w].join();
+    }
+    double wall = std::chrono::duration<double>(Clock::now() - t0).count();
+    for (int c = 0; c < clients; c++)
+    {
+        ::close(fds[c]);
+    }
+
+    FILE *out = stdout;
+    if (outputName != nullptr && std::strcmp(outputName, "-") != 0)
+    {
+        out = std::fopen(outputName, "w");
+        if (out == nullptr)
+        {
+            std::cerr << "cannot open output file " << outputName << "\n";
+            return 1;
+        }
+    }
+    static char outBuffer[1 << 16];
+    std::setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+    std::fprintf(out, "case,node,x,T,boundary\n");
+    std::vector<double> times;
+    for (size_t i = 0; i < replies.size(); i++)
+    {
+        const SolveReply &r = replies[i];
+        if (!answered[i])
+        {
+            std::cerr << "case " << i+1 << ": no reply\n";
+            status = 1;
+            continue;
+        }
+        if (r.status != SolveStatus::OK && r.status != SolveStatus::NOT_CONVERGED)
+        {
+            std::cerr << "case " << i+1 << ": " << r.error << ", skipped\n";
+            status = 1;
+            continue;
+        }
+        if (r.status == SolveStatus::NOT_CONVERGED)
+        {
+            std::cerr << "case " << i+1 << ": not converged\n";
+            status = 1;
+        }
+        times.push_back(roundTrip[i]);
+        for (Eigen::Index j = 0; j < r.nodalSolution.size(); j++)
+        {
+            std::fprintf(out, "%zu,%d,%.12g,%.12g,%.12g\n", i+1, (int)j,
+                         r.nodalXVals(j), r.nodalSolution(j), r.boundaryValues(j));
+        }
+    }
+    std::fflush(out);
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    std::sort(times.begin(), times.end());
+    if (!times.empty())
+    {
+        std::fprintf(stderr, "%zu cases in %.3f s, %.0f cases/s, round trip p50 %.3f p99 %.3f ms\n",
+                     replies.size(), wall, replies.size()/wall, 1.0e3*times[times.size()/2],
+                     1.0e3*times[std::min(times.size() - 1, (size_t)(0.99*times.size()))]);
+    }
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *socketName = nullptr;
+    const char *connectName = nullptr;
+    const char *inputName = nullptr;
+    const char *outputName = nullptr;
+    int threads = 0;
+    int maxBatch = 256;
+    int maxQueue = 65536;
+    double statsEvery = 0.0;
+    int clients = 1;
+    bool binary = false;
+    bool stats = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--socket") == 0 && i+1 < argc)
+        {
+            socketName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--connect") == 0 && i+1 < argc)
+        {
+            connectName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-i") == 0 && i+1 < argc)
+        {
+            inputName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-o") == 0 && i+1 < argc)
+        {
+            outputName = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+        {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--max-batch") == 0 && i+1 < argc)
+        {
+            maxBatch = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--max-queue") == 0 && i+1 < argc)
+        {
+            maxQueue = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--stats-every") == 0 && i+1 < argc)
+        {
+            statsEvery = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--clients") == 0 && i+1 < argc)
+        {
+            clients = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--binary") == 0)
+        {
+            binary = true;
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            stats = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if ((socketName == nullptr) == (connectName == nullptr))
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (socketName != nullptr)
+    {
+        return runServer(socketName, threads, maxBatch, maxQueue, statsEvery);
+    }
+    if (stats)
+    {
+        return runStats(connectName);
+    }
+    return runClient(connectName, inputName, outputName, binary, clients);
+}
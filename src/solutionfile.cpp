@@ -0,0 +1,343 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "solutionfile.h"
+
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[8] = { 'V', 'M', 'C', 'S', 'O', 'L', '\0', '\0' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const size_t HEADER_SIZE = 64;
+
+bool writeSolutionBinary( const std::string &fileName, const FiniteElementSolution &sol,
+                          const SolutionFileInfo &info, std::string &error )
+{
+    uint64_t n = sol.nodalSolution.size();
+    if ((uint64_t)sol.nodalXVals.size() != n || (uint64_t)sol.boundaryValues.size() != n)
+    {
+        error = "solution vectors differ in length";
+        return false;
+    }
+
+    unsigned char header[HEADER_SIZE] = {};
+    uint32_t version = SOLUTION_FILE_VERSION;
+    uint32_t units = (uint32_t)info.units;
+    uint32_t coord = (uint32_t)info.coord;
+    uint32_t element = (uint32_t)info.element;
+    std::memcpy(header, MAGIC, 8);
+    std::memcpy(header + 8, &version, 4);
+    std::memcpy(header + 12, &BYTE_ORDER_MARK, 4);
+    std::memcpy(header + 16, &n, 8);
+    std::memcpy(header + 24, &units, 4);
+    std::memcpy(header + 28, &coord, 4);
+    std::memcpy(header + 32, &element, 4);
+
+    FILE *file = std::fopen(fileName.c_str(), "wb");
+    if (file == nullptr)
+    {
+        error = "cannot open " + fileName + " for writing";
+        return false;
+    }
+    bool ok = std::fwrite(header, 1, HEADER_SIZE, file) == HEADER_SIZE
+        && std::fwrite(sol.nodalXVals.data(), sizeof(double), n, file) == n
+        && std::fwrite(sol.nodalSolution.data(), sizeof(double), n, file) == n
+        && std::fwrite(sol.boundaryValues.data(), sizeof(double), n, file) == n;
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        error = "cannot write " + fileName;
+    }
+    return ok;
+}
+
+CsvSolutionWriter::CsvSolutionWriter()
+{
+    file = nullptr;
+    failed = false;
+    used = 0;
+}
+
+CsvSolutionWriter::~CsvSolutionWriter()
+{
+    close();
+}
+
+bool CsvSolutionWriter::open( const std::string &fileName, std::string &error )
+{
+    close();
+    file = std::fopen(fileName.c_str(), "w");
+    if (file == nullptr)
+    {
+        error = "cannot open " + fileName + " for writing";
+        return false;
+    }
+    // rows are collected in our own buffer, stdio does not need one
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    failed = false;
+    used = 0;
+    const char header[] = "node,x,T,boundary\n";
+    std::memcpy(buffer, header, sizeof(header) - 1);
+    used = sizeof(header) - 1;
+    return true;
+}
+
+void CsvSolutionWriter::flush()
+{
+    if (used > 0 && std::fwrite(buffer, 1, used, file) != used)
+    {
+        failed = true;
+    }
+    used = 0;
+}
+
+bool CsvSolutionWriter::write( const FiniteElementSolution &sol )
+{
+    if (file == nullptr)
+    {
+        return false;
+    }
+    // one row is at most 3 values of %.17g plus the node number
+    const size_t longestRow = 96;
+    int n = sol.nodalSolution.size();
+    for (int i = 0; i < n; i++)
+    {
+        if (sizeof(buffer) - used < longestRow)
+        {
+            flush();
+        }
+        used += std::snprintf(buffer + used, sizeof(buffer) - used, "%d,%.17g,%.17g,%.17g\n",
+                              i, sol.nodalXVals(i), sol.nodalSolution(i), sol.boundaryValues(i));
+    }
+    return !failed;
+}
+
+bool CsvSolutionWriter::close()
+{
+    if (file == nullptr)
+    {
+        return !failed;
+    }
+    flush();
+    if (std::fclose(file) != 0)
+    {
+        failed = true;
+    }
+    file = nullptr;
+    return !failed;
+}
+
+SolutionFile::SolutionFile()
+{
+    data = nullptr;
+    length = 0;
+    mapped = false;
+    nodes = 0;
+    fileInfo.units = UnitSystem::SI;
+    fileInfo.coord = CoordType::CARTESIAN;
+    fileInfo.element = ElementType::LINEAR;
+}
+
+SolutionFile::~SolutionFile()
+{
+    close();
+}
+
+bool SolutionFile::open( const std::string &fileName, std::string &error )
+{
+    close();
+#ifndef _WIN32
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        error = "cannot open " + fileName;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE)
+    {
+        ::close(fd);
+        error = fileName + " is not a solution file";
+        return false;
+    }
+    void *map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        error = "cannot map " + fileName;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(map);
+    length = st.st_size;
+    mapped = true;
+#else
+    FILE *file = std::fopen(fileName.c_str(), "rb");
+    if (file == nullptr)
+    {
+        error = "cannot open " + fileName;
+        return false;
+    }
+    std::vector<unsigned char> bytes;
+    unsigned char chunk[1 << 16];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        bytes.insert(bytes.end(), chunk, chunk + got);
+    }
+    std::fclose(file);
+    // doubles need their alignment, so copy into a double array
+    double *copy = new double[(bytes.size() + sizeof(double) - 1)/sizeof(double)];
+    std::memcpy(copy, bytes.data(), bytes.size());
+    data = reinterpret_cast<const unsigned char*>(copy);
+    length = bytes.size();
+    mapped = false;
+    if (length < HEADER_SIZE)
+    {
+        close();
+        error = fileName + " is not a solution file";
+        return false;
+    }
+#endif
+
+    uint32_t version, mark, units, coord, element;
+    uint64_t n;
+    std::memcpy(&version, data + 8, 4);
+    std::memcpy(&mark, data + 12, 4);
+    std::memcpy(&n, data + 16, 8);
+    std::memcpy(&units, data + 24, 4);
+    std::memcpy(&coord, data + 28, 4);
+    std::memcpy(&element, data + 32, 4);
+    if (std::memcmp(data, MAGIC, 8) != 0)
+    {
+        error = fileName + " is not a solution file";
+    }
+    else if (version != SOLUTION_FILE_VERSION)
+    {
+        error = fileName + " has unsupported version " + std::to_string(version);
+    }
+    else if (mark != BYTE_ORDER_MARK)
+    {
+        error = fileName + " was written with a different byte order";
+    }
+    else if (units > (uint32_t)UnitSystem::ENGLISH)
+    {
+        error = fileName + " has unknown unit system " + std::to_string(units);
+    }
+    else if (coord > (uint32_t)CoordType::CYLINDRICAL)
+    {
+        error = fileName + " has unknown coordinate type " + std::to_string(coord);
+    }
+    else if (element < (uint32_t)ElementType::LINEAR || element > (uint32_t)ElementType::CUBIC)
+    {
+        error = fileName + " has unknown element type " + std::to_string(element);
+    }
+    else if (n > (length - HEADER_SIZE)/(3*sizeof(double)))
+    {
+        error = fileName + " is truncated";
+    }
+    else
+    {
+        nodes = n;
+        fileInfo.units = (UnitSystem)units;
+        fileInfo.coord = (CoordType)coord;
+        fileInfo.element = (ElementType)element;
+        return true;
+    }
+    close();
+    return false;
+}
+
+void SolutionFile::close()
+{
+    if (data != nullptr)
+    {
+#ifndef _WIN32
+        if (mapped)
+        {
+            ::munmap(const_cast<unsigned char*>(data), length);
+        }
+        else
+#endif
+        {
+            delete[] reinterpret_cast<const double*>(data);
+        }
+    }
+    data = nullptr;
+    length = 0;
+    mapped = false;
+    nodes = 0;
+}
+
+size_t SolutionFile::size() const
+{
+    return nodes;
+}
+
+const SolutionFileInfo &SolutionFile::info() const
+{
+    return fileInfo;
+}
+
+const double *SolutionFile::column( int which ) const
+{
+    return reinterpret_cast<const double*>(data + HEADER_SIZE) + which*nodes;
+}
+
+Eigen::Map<const Eigen::VectorXd> SolutionFile::nodalXVals() const
+{
+    return Eigen::Map<const Eigen::VectorXd>(column(0), nodes);
+}
+
+Eigen::Map<const Eigen::VectorXd> SolutionFile::nodalSolution() const
+{
+    return Eigen::Map<const Eigen::VectorXd>(column(1), nodes);
+}
+
+Eigen::Map<const Eigen::VectorXd> SolutionFile::boundaryValues() const
+{
+    return Eigen::Map<const Eigen::VectorXd>(column(2), nodes);
+}
+
+const unsigned char *SolutionFile::trailer() const
+{
+    return data + HEADER_SIZE + 3*sizeof(double)*nodes;
+}
+
+size_t SolutionFile::trailerSize() const
+{
+    return (data == nullptr) ? 0 : length - HEADER_SIZE - 3*sizeof(double)*nodes;
+}
+
+FiniteElementSolution SolutionFile::toSolution() const
+{
+    FiniteElementSolution sol {};
+    sol.nodalXVals = nodalXVals();
+    sol.nodalSolution = nodalSolution();
+    sol.boundaryValues = boundaryValues();
+    sol.cancelled = false;
+    return sol;
+}
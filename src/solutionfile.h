@@ -0,0 +1,123 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef SOLUTIONFILE_H
+#define SOLUTIONFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <eigen3/Eigen/Dense>
+
+#include "finiteelementmodel.h"
+
+// binary result file, version 1, native byte order:
+//   0   char[8]  magic "VMCSOL\0\0"
+//   8   uint32   version
+//   12  uint32   byte order mark 0x01020304, as written by the producer
+//   16  uint64   node count n
+//   24  uint32   unit system of the stored values
+//   28  uint32   coordinate system
+//   32  uint32   element order
+//   36  ...      zero up to 64
+//   64  double[n] nodalXVals, then nodalSolution, then boundaryValues
+// every array starts on an 8 byte boundary, so a mapped file can be
+// read in place
+const uint32_t SOLUTION_FILE_VERSION = 1;
+
+typedef struct
+{
+    UnitSystem units; // units the values are in, not the model's
+    CoordType coord;
+    ElementType element;
+}
+SolutionFileInfo;
+
+// writes the three nodal vectors straight from the solution, without
+// an intermediate copy; false and a message on failure
+bool writeSolutionBinary( const std::string &fileName, const FiniteElementSolution &sol,
+                          const SolutionFileInfo &info, std::string &error );
+
+// CSV with a node,x,T,boundary header; rows are formatted into a fixed
+// size buffer that is written out whenever it fills up, so the text of
+// a large solution never exists in memory as a whole
+class CsvSolutionWriter
+{
+
+public:
+    CsvSolutionWriter();
+    ~CsvSolutionWriter();
+
+    bool open( const std::string &fileName, std::string &error );
+    // rows for every node; may be called for several solutions, the
+    // node column then restarts at 0
+    bool write( const FiniteElementSolution &sol );
+    bool close(); // false if anything could not be written
+
+private:
+    void flush();
+
+    FILE *file;
+    bool failed;
+    size_t used;
+    char buffer[1 << 16];
+};
+
+// read access to a binary result file. The file is memory mapped where
+// the platform allows it, so opening is independent of the file size and
+// the vectors are views into the mapping, valid until close()
+class SolutionFile
+{
+
+public:
+    SolutionFile();
+    ~SolutionFile();
+    SolutionFile( const SolutionFile& ) = delete;
+    SolutionFile &operator=( const SolutionFile& ) = delete;
+
+    bool open( const std::string &fileName, std::string &error );
+    void close();
+
+    size_t size() const;
+    const SolutionFileInfo &info() const;
+    Eigen::Map<const Eigen::VectorXd> nodalXVals() const;
+    Eigen::Map<const Eigen::VectorXd> nodalSolution() const;
+    Eigen::Map<const Eigen::VectorXd> boundaryValues() const;
+
+    // copy into an ordinary solution, e.g. to plot it
+    FiniteElementSolution toSolution() const;
+
+    // bytes after the three arrays, skipped by readers of the format;
+    // ResultCache keeps its key and the solver statistics there
+    const unsigned char *trailer() const;
+    size_t trailerSize() const;
+
+private:
+    const double *column( int which ) const;
+
+    const unsigned char *data;
+    size_t length;
+    bool mapped; // otherwise data was read into the heap
+    size_t nodes;
+    SolutionFileInfo fileInfo;
+};
+
+#endif // SOLUTIONFILE_H
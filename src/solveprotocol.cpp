@@ -0,0 +1,707 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "solveprotocol.h"
+#include "caseparser.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+static const char REQUEST_MAGIC[4] = { 'V', 'C', 'Q', '1' };
+static const char REPLY_MAGIC[4] = { 'V', 'C', 'R', '1' };
+static const size_t REQUEST_HEADER = 16;
+
+// a parsed JSON value; numbers keep their text, a view into the
+// payload, so case values reach the model exactly as they were written
+typedef struct JsonValue
+{
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type;
+    std::string text; // string, or "true"/"false"
+    double number;
+    std::string_view numberText;
+    std::vector<JsonValue> items;
+    std::vector< std::pair<std::string, JsonValue> > members;
+}
+JsonValue;
+
+// recursive descent over the whole payload, no extensions
+class JsonReader
+{
+
+public:
+    JsonReader( const std::string &text ) : s(text), pos(0) {}
+
+    bool parse( JsonValue &value )
+    {
+        if (!parseValue(value, 0))
+        {
+            return false;
+        }
+        skipSpace();
+        return pos == s.size();
+    }
+
+private:
+    void skipSpace()
+    {
+        while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r'))
+        {
+            pos++;
+        }
+    }
+
+    bool literal( const char *word )
+    {
+        size_t len = std::strlen(word);
+        if (s.compare(pos, len, word) != 0)
+        {
+            return false;
+        }
+        pos += len;
+        return true;
+    }
+
+    bool parseString( std::string &out )
+    {
+        pos++; // opening quote
+        out.clear();
+        while (pos < s.size())
+        {
+            char c = s[pos++];
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (pos >= s.size())
+            {
+                return false;
+            }
+            char e = s[pos++];
+            switch (e)
+            {
+                case '"': case '\\': case '/': out += e; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    // case keys and values are ASCII, anything else is
+                    // passed on as UTF-8 for the error message
+                    if (pos + 4 > s.size())
+                    {
+                        return false;
+                    }
+                    unsigned code = (unsigned)std::strtoul(s.substr(pos, 4).c_str(), nullptr, 16);
+                    pos += 4;
+                    if (code < 0x80)
+                    {
+                        out += (char)code;
+                    }
+                    else if (code < 0x800)
+                    {
+                        out += (char)(0xC0 | (code >> 6));
+                        out += (char)(0x80 | (code & 0x3F));
+                    }
+                    else
+                    {
+                        out += (char)(0xE0 | (code >> 12));
+                        out += (char)(0x80 | ((code >> 6) & 0x3F));
+                        out += (char)(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseValue( JsonValue &value, int depth )
+    {
+        skipSpace();
+        if (pos >= s.size() || depth > 8)
+        {
+            return false;
+        }
+        char c = s[pos];
+        if (c == '{')
+        {
+            value.type = JsonValue::OBJECT;
+            pos++;
+            skipSpace();
+            if (pos < s.size() && s[pos] == '}')
+            {
+                pos++;
+                return true;
+            }
+            while (true)
+            {
+                skipSpace();
+                std::pair<std::string, JsonValue> member;
+                if (pos >= s.size() || s[pos] != '"' || !parseString(member.first))
+                {
+                    return false;
+                }
+                skipSpace();
+                if (pos >= s.size() || s[pos++] != ':' || !parseValue(member.second, depth+1))
+                {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+                skipSpace();
+                if (pos < s.size() && s[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                return pos < s.size() && s[pos++] == '}';
+            }
+        }
+        if (c == '[')
+        {
+            value.type = JsonValue::ARRAY;
+            pos++;
+            skipSpace();
+            if (pos < s.size() && s[pos] == ']')
+            {
+                pos++;
+                return true;
+            }
+            while (true)
+            {
+                JsonValue item;
+                if (!parseValue(item, depth+1))
+                {
+                    return false;
+                }
+                value.items.push_back(std::move(item));
+                skipSpace();
+                if (pos < s.size() && s[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                return pos < s.size() && s[pos++] == ']';
+            }
+        }
+        if (c == '"')
+        {
+            value.type = JsonValue::STRING;
+            return parseString(value.text);
+        }
+        if (literal("true"))
+        {
+            value.type = JsonValue::BOOLEAN;
+            value.text = "true";
+            return true;
+        }
+        if (literal("false"))
+        {
+            value.type = JsonValue::BOOLEAN;
+            value.text = "false";
+            return true;
+        }
+        if (literal("null"))
+        {
+            value.type = JsonValue::NUL;
+            return true;
+        }
+        // JSON numbers have no leading '+', from_chars takes none either
+        const char *start = s.data() + pos;
+        std::from_chars_result read = std::from_chars(start, s.data() + s.size(), value.number);
+        if (read.ec != std::errc())
+        {
+            return false;
+        }
+        value.type = JsonValue::NUMBER;
+        value.numberText = std::string_view(start, read.ptr - start);
+        pos += read.ptr - start;
+        return true;
+    }
+
+    const std::string &s;
+    size_t pos;
+};
+
+static const JsonValue *findMember( const JsonValue &object, const char *name )
+{
+    for (size_t i = 0; i < object.members.size(); i++)
+    {
+        if (object.members[i].first == name)
+        {
+            return &object.members[i].second;
+        }
+    }
+    return nullptr;
+}
+
+static bool readNumbers( const JsonValue *array, VectorXd &values )
+{
+    if (array == nullptr || array->type != JsonValue::ARRAY)
+    {
+        return false;
+    }
+    values.resize(array->items.size());
+    for (size_t i = 0; i < array->items.size(); i++)
+    {
+        if (array->items[i].type != JsonValue::NUMBER)
+        {
+            return false;
+        }
+        values(i) = array->items[i].number;
+    }
+    return true;
+}
+
+// one member of a JSON request as case key=value pairs
+static bool memberPairs( const std::string &key, const JsonValue &value,
+                         std::vector< std::pair<std::string, std::string> > &pairs )
+{
+    if (value.type == JsonValue::NUMBER)
+    {
+        pairs.push_back( std::make_pair(key, std::string(value.numberText)) );
+        return true;
+    }
+    if (value.type == JsonValue::STRING)
+    {
+        pairs.push_back( std::make_pair(key, value.text) );
+        return true;
+    }
+    if (value.type != JsonValue::ARRAY || value.items.empty())
+    {
+        return false;
+    }
+    if (value.items[0].type == JsonValue::NUMBER)
+    {
+        std::string joined;
+        for (size_t i = 0; i < value.items.size(); i++)
+        {
+            if (value.items[i].type != JsonValue::NUMBER)
+            {
+                return false;
+            }
+            joined += (i > 0 ? ":" : "");
+            joined += value.items[i].numberText;
+        }
+        pairs.push_back( std::make_pair(key, joined) );
+        return true;
+    }
+    // repeated keys such as layer, one element each
+    for (size_t i = 0; i < value.items.size(); i++)
+    {
+        const JsonValue &item = value.items[i];
+        if (item.type == JsonValue::STRING)
+        {
+            pairs.push_back( std::make_pair(key, item.text) );
+        }
+        else if (item.type != JsonValue::ARRAY || !memberPairs(key, item, pairs))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace SolveProtocol
+{
+
+bool readFrame( int fd, std::string &payload, uint32_t limit, bool *closed )
+{
+    if (closed != nullptr)
+    {
+        *closed = false;
+    }
+    uint32_t length = 0;
+    char *dst = (char *)&length;
+    size_t want = sizeof(length);
+    bool header = true;
+    while (true)
+    {
+        while (want > 0)
+        {
+            ssize_t got = ::recv(fd, dst, want, 0);
+            if (got < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (got <= 0)
+            {
+                if (closed != nullptr)
+                {
+                    *closed = (got == 0 && header && want == sizeof(length));
+                }
+                return false;
+            }
+            dst += got;
+            want -= got;
+        }
+        if (!header)
+        {
+            return true;
+        }
+        if (length > limit)
+        {
+            return false;
+        }
+        header = false;
+        payload.resize(length);
+        dst = &payload[0];
+        want = length;
+    }
+}
+
+// gathered write of every buffer, continued after short writes
+static bool writeAll( int fd, struct iovec *parts, int count )
+{
+    while (count > 0)
+    {
+        struct msghdr message = {};
+        message.msg_iov = parts;
+        message.msg_iovlen = count;
+        // MSG_NOSIGNAL: a client that went away is an error, not SIGPIPE
+        ssize_t sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent < 0)
+        {
+            return false;
+        }
+        while (count > 0 && (size_t)sent >= parts->iov_len)
+        {
+            sent -= parts->iov_len;
+            parts++;
+            count--;
+        }
+        if (count > 0)
+        {
+            parts->iov_base = (char *)parts->iov_base + sent;
+            parts->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+bool writeFrame( int fd, const std::string &payload )
+{
+    uint32_t length = payload.size();
+    struct iovec parts[2];
+    parts[0].iov_base = &length;
+    parts[0].iov_len = sizeof(length);
+    parts[1].iov_base = (void *)payload.data();
+    parts[1].iov_len = payload.size();
+    return writeAll(fd, parts, 2);
+}
+
+bool decodeRequest( const std::string &payload, SolveRequest &request, std::string &error )
+{
+    request.id = 0;
+    request.reply = ReplyFormat::JSON;
+    request.stats = false;
+    request.pairs.clear();
+
+    if (payload.size() >= REQUEST_HEADER && std::memcmp(payload.data(), REQUEST_MAGIC, 4) == 0)
+    {
+        std::memcpy(&request.id, payload.data() + 8, 8);
+        request.reply = ReplyFormat::BINARY;
+        return splitCase(payload.substr(REQUEST_HEADER), request.pairs, error);
+    }
+
+    JsonValue root;
+    JsonReader reader(payload);
+    if (!reader.parse(root) || root.type != JsonValue::OBJECT)
+    {
+        error = "request is neither a JSON object nor a binary request";
+        return false;
+    }
+    for (size_t i = 0; i < root.members.size(); i++)
+    {
+        const std::string &key = root.members[i].first;
+        const JsonValue &value = root.members[i].second;
+        if (key == "id")
+        {
+            std::from_chars_result read = std::from_chars(value.numberText.data(),
+                value.numberText.data() + value.numberText.size(), request.id);
+            if (value.type != JsonValue::NUMBER || read.ec != std::errc()
+                || read.ptr != value.numberText.data() + value.numberText.size())
+            {
+                error = "id must be a non-negative integer";
+                return false;
+            }
+        }
+        else if (key == "reply")
+        {
+            if (value.text != "json" && value.text != "binary")
+            {
+                error = "reply must be \"json\" or \"binary\"";
+                return false;
+            }
+            request.reply = (value.text == "binary") ? ReplyFormat::BINARY : ReplyFormat::JSON;
+        }
+        else if (key == "command")
+        {
+            if (value.text != "stats")
+            {
+                error = "unknown command '" + value.text + "'";
+                return false;
+            }
+            request.stats = true;
+        }
+        else if (!memberPairs(key, value, request.pairs))
+        {
+            error = "bad value for '" + key + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string encodeJsonRequest( uint64_t id, ReplyFormat reply,
+                               const std::vector< std::pair<std::string, std::string> > &pairs )
+{
+    std::string text = "{\"id\": " + std::to_string(id) + ", \"reply\": "
+        + (reply == ReplyFormat::BINARY ? "\"binary\"" : "\"json\"");
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        text += ", " + quote(pairs[i].first) + ": " + quote(pairs[i].second);
+    }
+    return text + "}";
+}
+
+std::string encodeBinaryRequest( uint64_t id, const std::string &caseLine )
+{
+    std::string payload(REQUEST_HEADER, '\0');
+    std::memcpy(&payload[0], REQUEST_MAGIC, 4);
+    std::memcpy(&payload[8], &id, 8);
+    return payload + caseLine;
+}
+
+static const char *statusName( SolveStatus status )
+{
+    switch (status)
+    {
+        case SolveStatus::OK: return "ok";
+        case SolveStatus::NOT_CONVERGED: return "not_converged";
+        case SolveStatus::BAD_REQUEST: return "error";
+        case SolveStatus::OVERLOADED: return "overloaded";
+    }
+    return "error";
+}
+
+// shortest text that reads back to the same double, several times
+// faster than printf with %.17g
+static void appendArray( std::string &text, const char *name, const VectorXd &values )
+{
+    char number[32];
+    text += ", \"";
+    text += name;
+    text += "\": [";
+    for (Eigen::Index i = 0; i < values.size(); i++)
+    {
+        if (i > 0)
+        {
+            text += ", ";
+        }
+        char *end = std::to_chars(number, number + sizeof(number), values(i)).ptr;
+        text.append(number, end - number);
+    }
+    text += "]";
+}
+
+bool writeSolution( int fd, ReplyFormat format, uint64_t id, SolveStatus status,
+                    const FiniteElementSolution &sol, UnitSystem units, CoordType coord,
+                    ElementType element, double seconds )
+{
+    // JSON has no inf or nan, and no reader of either form expects them
+    if (!sol.nodalXVals.allFinite() || !sol.nodalSolution.allFinite() || !sol.boundaryValues.allFinite())
+    {
+        return writeError(fd, format, id, SolveStatus::BAD_REQUEST, "solution is not finite");
+    }
+    uint32_t n = sol.nodalSolution.size();
+    if (format == ReplyFormat::JSON)
+    {
+        char head[160];
+        std::snprintf(head, sizeof(head), "{\"id\": %llu, \"status\": \"%s\", \"nodes\": %u, "
+                      "\"units\": \"%s\", \"seconds\": %.6e", (unsigned long long)id, statusName(status),
+                      n, units == UnitSystem::ENGLISH ? "english" : "si", seconds);
+        std::string text = head;
+        text.reserve(text.size() + 3*26*(size_t)n + 64);
+        appendArray(text, "x", sol.nodalXVals);
+        appendArray(text, "T", sol.nodalSolution);
+        appendArray(text, "boundary", sol.boundaryValues);
+        text += "}";
+        return writeFrame(fd, text);
+    }
+
+    unsigned char header[binaryHeader] = {};
+    int32_t code = (int32_t)status;
+    std::memcpy(header, REPLY_MAGIC, 4);
+    std::memcpy(header + 4, &code, 4);
+    std::memcpy(header + 8, &id, 8);
+    std::memcpy(header + 16, &n, 4);
+    header[20] = (unsigned char)units;
+    header[21] = (unsigned char)coord;
+    header[22] = (unsigned char)element;
+    std::memcpy(header + 24, &seconds, 8);
+
+    uint32_t length = binaryHeader + 3*sizeof(double)*(size_t)n;
+    struct iovec parts[5];
+    parts[0].iov_base = &length;
+    parts[0].iov_len = sizeof(length);
+    parts[1].iov_base = header;
+    parts[1].iov_len = binaryHeader;
+    parts[2].iov_base = (void *)sol.nodalXVals.data();
+    parts[3].iov_base = (void *)sol.nodalSolution.data();
+    parts[4].iov_base = (void *)sol.boundaryValues.data();
+    parts[2].iov_len = parts[3].iov_len = parts[4].iov_len = sizeof(double)*(size_t)n;
+    return writeAll(fd, parts, 5);
+}
+
+bool writeError( int fd, ReplyFormat format, uint64_t id, SolveStatus status,
+                 const std::string &message )
+{
+    if (format == ReplyFormat::JSON)
+    {
+        return writeFrame(fd, "{\"id\": " + std::to_string(id) + ", \"status\": \""
+                          + statusName(status) + "\", \"error\": " + quote(message) + "}");
+    }
+    std::string payload(binaryHeader, '\0');
+    int32_t code = (int32_t)status;
+    std::memcpy(&payload[0], REPLY_MAGIC, 4);
+    std::memcpy(&payload[4], &code, 4);
+    std::memcpy(&payload[8], &id, 8);
+    return writeFrame(fd, payload + message);
+}
+
+bool decodeReply( const std::string &payload, SolveReply &reply, std::string &error )
+{
+    reply.error.clear();
+    reply.seconds = 0.0;
+    reply.units = UnitSystem::SI;
+    if (payload.size() >= binaryHeader && std::memcmp(payload.data(), REPLY_MAGIC, 4) == 0)
+    {
+        int32_t code = 0;
+        uint32_t n = 0;
+        std::memcpy(&code, payload.data() + 4, 4);
+        std::memcpy(&reply.id, payload.data() + 8, 8);
+        std::memcpy(&n, payload.data() + 16, 4);
+        std::memcpy(&reply.seconds, payload.data() + 24, 8);
+        reply.status = (SolveStatus)code;
+        reply.units = (UnitSystem)payload[20];
+        if (reply.status != SolveStatus::OK && reply.status != SolveStatus::NOT_CONVERGED)
+        {
+            reply.error = payload.substr(binaryHeader);
+            return true;
+        }
+        if (payload.size() != binaryHeader + 3*sizeof(double)*(size_t)n)
+        {
+            error = "binary reply has the wrong length";
+            return false;
+        }
+        const char *values = payload.data() + binaryHeader;
+        reply.nodalXVals.resize(n);
+        reply.nodalSolution.resize(n);
+        reply.boundaryValues.resize(n);
+        std::memcpy(reply.nodalXVals.data(), values, sizeof(double)*n);
+        std::memcpy(reply.nodalSolution.data(), values + sizeof(double)*n, sizeof(double)*n);
+        std::memcpy(reply.boundaryValues.data(), values + 2*sizeof(double)*n, sizeof(double)*n);
+        return true;
+    }
+
+    JsonValue root;
+    JsonReader reader(payload);
+    if (!reader.parse(root) || root.type != JsonValue::OBJECT)
+    {
+        error = "reply is neither JSON nor binary";
+        return false;
+    }
+    const JsonValue *id = findMember(root, "id");
+    const JsonValue *status = findMember(root, "status");
+    if (id == nullptr || status == nullptr)
+    {
+        error = "reply without id or status";
+        return false;
+    }
+    reply.id = 0;
+    std::from_chars(id->numberText.data(), id->numberText.data() + id->numberText.size(), reply.id);
+    reply.status = (status->text == "ok") ? SolveStatus::OK
+        : (status->text == "not_converged") ? SolveStatus::NOT_CONVERGED
+        : (status->text == "overloaded") ? SolveStatus::OVERLOADED : SolveStatus::BAD_REQUEST;
+    if (reply.status != SolveStatus::OK && reply.status != SolveStatus::NOT_CONVERGED)
+    {
+        const JsonValue *message = findMember(root, "error");
+        reply.error = (message != nullptr) ? message->text : status->text;
+        return true;
+    }
+    const JsonValue *units = findMember(root, "units");
+    const JsonValue *seconds = findMember(root, "seconds");
+    reply.units = (units != nullptr && units->text == "english") ? UnitSystem::ENGLISH : UnitSystem::SI;
+    reply.seconds = (seconds != nullptr) ? seconds->number : 0.0;
+    if (!readNumbers(findMember(root, "x"), reply.nodalXVals)
+        || !readNumbers(findMember(root, "T"), reply.nodalSolution)
+        || !readNumbers(findMember(root, "boundary"), reply.boundaryValues))
+    {
+        error = "reply without x, T or boundary values";
+        return false;
+    }
+    return true;
+}
+
+std::string quote( const std::string &text )
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += (char)c;
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else
+        {
+            out += (char)c;
+        }
+    }
+    return out + "\"";
+}
+
+}
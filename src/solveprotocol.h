@@ -0,0 +1,141 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef SOLVEPROTOCOL_H
+#define SOLVEPROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "finiteelementmodel.h"
+
+// wire format of the local solve server. Every message in either
+// direction is a frame: a uint32 payload length followed by the
+// payload. The socket is local, so every number is in native byte
+// order.
+//
+// A request payload is either a JSON object or a binary request:
+//   {"id": 7, "reply": "json", "a": 0, "b": 2, "k": 2, "coord": "cylindrical",
+//    "k_table": [300, 45, 600, 38], "layer": ["0.01:45:0", "0.11:0.04:0"]}
+// every member other than id, reply and command is a key of the case
+// language (caseparser.h); numbers and strings are used as they are,
+// an array of numbers is joined with ':' and an array of strings or
+// arrays gives the key once per element. reply is "json" (default) or
+// "binary". {"command": "stats"} asks for the server statistics.
+//
+// binary request:
+//   0   char[4]  magic "VCQ1"
+//   4   uint32   zero
+//   8   uint64   id
+//   16  ...      the case as one key=value line, not terminated
+//
+// binary reply, a 32 byte header followed by three arrays of doubles,
+// each on an 8 byte boundary; the text of an error follows the header
+// instead:
+//   0   char[4]  magic "VCR1"
+//   4   int32    SolveStatus
+//   8   uint64   id of the request
+//   16  uint32   node count n
+//   20  uint8    unit system of the values
+//   21  uint8    coordinate system
+//   22  uint8    element order
+//   23  uint8    zero
+//   24  double   seconds from receiving the request to the reply
+//   32  double[n] nodalXVals, then nodalSolution, then boundaryValues
+//
+// JSON replies carry the same fields as members:
+//   {"id": 7, "status": "ok", "nodes": n, "units": "si", "seconds": ...,
+//    "x": [...], "T": [...], "boundary": [...]}
+// or "status": "error" with an "error" message.
+
+enum class SolveStatus : int32_t
+{
+    OK = 0,
+    NOT_CONVERGED = 1, // k(T) iteration stopped early, values are the last iterate
+    BAD_REQUEST = 2, // message in place of the values
+    OVERLOADED = 3 // queue full, request dropped, try again
+};
+
+enum class ReplyFormat
+{
+    JSON, BINARY
+};
+
+// one decoded request; pairs are the case in the key=value language
+typedef struct
+{
+    uint64_t id;
+    ReplyFormat reply;
+    bool stats; // command "stats", no case
+    std::vector< std::pair<std::string, std::string> > pairs;
+}
+SolveRequest;
+
+// one decoded reply, values in the units given
+typedef struct
+{
+    uint64_t id;
+    SolveStatus status;
+    std::string error;
+    UnitSystem units;
+    double seconds;
+    VectorXd nodalXVals;
+    VectorXd nodalSolution;
+    VectorXd boundaryValues;
+}
+SolveReply;
+
+namespace SolveProtocol
+{
+    const uint32_t maxRequest = 1u << 24; // bytes, larger frames end the connection
+    const size_t binaryHeader = 32;
+
+    // whole frames over a connected socket, retried on EINTR and short
+    // transfers; false on end of file, an error or an oversized frame.
+    // closed, if given, tells an orderly end of file between two frames
+    // from the other cases
+    bool readFrame( int fd, std::string &payload, uint32_t limit, bool *closed = nullptr );
+    bool writeFrame( int fd, const std::string &payload );
+
+    // false and a message if the payload is neither form
+    bool decodeRequest( const std::string &payload, SolveRequest &request, std::string &error );
+    std::string encodeJsonRequest( uint64_t id, ReplyFormat reply,
+                                   const std::vector< std::pair<std::string, std::string> > &pairs );
+    std::string encodeBinaryRequest( uint64_t id, const std::string &caseLine );
+
+    // a solved case; the nodal vectors are sent straight from sol, in
+    // one gathered write with the header and without an intermediate copy.
+    // A solution with inf or nan values goes out as a BAD_REQUEST error
+    bool writeSolution( int fd, ReplyFormat format, uint64_t id, SolveStatus status,
+                        const FiniteElementSolution &sol, UnitSystem units, CoordType coord,
+                        ElementType element, double seconds );
+    bool writeError( int fd, ReplyFormat format, uint64_t id, SolveStatus status,
+                     const std::string &message );
+
+    bool decodeReply( const std::string &payload, SolveReply &reply, std::string &error );
+
+    // JSON string literal with quotes and escapes
+    std::string quote( const std::string &text );
+}
+
+#endif // SOLVEPROTOCOL_H
@@ -0,0 +1,546 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "solveserver.h"
+#include "caseparser.h"
+#include "profiler.h"
+#include "rodbatch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+SolveServer::Connection::~Connection()
+{
+    ::close(fd);
+}
+
+SolveServer::SolveServer()
+{
+    threads = 0;
+    maxBatch = 256;
+    maxQueue = 65536;
+    listenFd = -1;
+    stopping = false;
+    inFlight = 0;
+    received = 0;
+    completed = 0;
+    failed = 0;
+    rejected = 0;
+    batches = 0;
+    batchedRequests = 0;
+    rodBatched = 0;
+    latencyNext = 0;
+}
+
+SolveServer::~SolveServer()
+{
+    stop();
+}
+
+void SolveServer::set_socket_path( const std::string &path )
+{
+    socketPath = path;
+}
+
+void SolveServer::set_threads( int new_threads )
+{
+    threads = std::max(new_threads, 0);
+}
+
+void SolveServer::set_max_batch( int new_max )
+{
+    maxBatch = std::max(new_max, 1);
+}
+
+void SolveServer::set_max_queue( int new_max )
+{
+    maxQueue = std::max(new_max, 1);
+}
+
+bool SolveServer::start( std::string &error )
+{
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+    {
+        error = "socket path is empty or too long";
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        error = std::string("cannot create socket: ") + std::strerror(errno);
+        return false;
+    }
+    // a socket file nobody answers on is left over from a crashed
+    // server and is replaced; one that answers belongs to a live one
+    if (::connect(listenFd, (struct sockaddr *)&address, sizeof(address)) == 0)
+    {
+        error = socketPath + " is in use by a running server";
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    ::close(listenFd);
+    struct stat existing;
+    if (::stat(socketPath.c_str(), &existing) == 0 && !S_ISSOCK(existing.st_mode))
+    {
+        error = socketPath + " exists and is not a socket";
+        listenFd = -1;
+        return false;
+    }
+    ::unlink(socketPath.c_str());
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || ::bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0
+        || ::listen(listenFd, 64) != 0)
+    {
+        error = "cannot listen on " + socketPath + ": " + std::strerror(errno);
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+        }
+        listenFd = -1;
+        return false;
+    }
+
+    stopping = false;
+    pool.reset(new ThreadPool(threads));
+    acceptor = std::thread(&SolveServer::acceptLoop, this);
+    dispatcher = std::thread(&SolveServer::dispatchLoop, this);
+    return true;
+}
+
+void SolveServer::stop()
+{
+    if (listenFd < 0)
+    {
+        return;
+    }
+    stopping = true;
+    acceptor.join();
+    ::close(listenFd);
+    listenFd = -1;
+    ::unlink(socketPath.c_str());
+
+    // readers see end of file once their sockets are shut down
+    std::vector< std::unique_ptr<Reader> > open;
+    {
+        std::lock_guard<std::mutex> guard(readersLock);
+        open.swap(readers);
+    }
+    for (size_t i = 0; i < open.size(); i++)
+    {
+        if (std::shared_ptr<Connection> connection = open[i]->connection.lock())
+        {
+            ::shutdown(connection->fd, SHUT_RDWR);
+        }
+        open[i]->thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(queueLock);
+        queue.clear();
+    }
+    queueReady.notify_all();
+    dispatcher.join();
+    pool.reset();
+}
+
+void SolveServer::acceptLoop()
+{
+    while (!stopping)
+    {
+        // wake up now and then to notice stop()
+        struct pollfd waiting = { listenFd, POLLIN, 0 };
+        if (::poll(&waiting, 1, 100) <= 0)
+        {
+            continue;
+        }
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        std::unique_ptr<Reader> reader(new Reader());
+        reader->connection = connection;
+        reader->finished = false;
+        std::lock_guard<std::mutex> guard(readersLock);
+        // join the threads of readers that have finished
+        for (size_t i = 0; i < readers.size(); )
+        {
+            if (readers[i]->finished)
+            {
+                readers[i]->thread.join();
+                readers[i] = std::move(readers.back());
+                readers.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+        reader->thread = std::thread(&SolveServer::readLoop, this, std::move(connection), reader.get());
+        readers.push_back(std::move(reader));
+    }
+}
+
+void SolveServer::readLoop( std::shared_ptr<Connection> connection, Reader *reader )
+{
+    std::string payload;
+    bool closed = false;
+    while (SolveProtocol::readFrame(connection->fd, payload, SolveProtocol::maxRequest, &closed))
+    {
+        Pending pending;
+        pending.received = Clock::now();
+        pending.connection = connection;
+        received++;
+
+        std::string error;
+        if (!SolveProtocol::decodeRequest(payload, pending.request, error))
+        {
+            replyError(pending, SolveStatus::BAD_REQUEST, error);
+            continue;
+        }
+        if (pending.request.stats)
+        {
+            std::lock_guard<std::mutex> guard(connection->writeLock);
+            SolveProtocol::writeFrame(connection->fd, statsJson());
+            continue;
+        }
+
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            if (queue.size() < maxQueue)
+            {
+                queue.push_back(std::move(pending));
+                queued = true;
+            }
+        }
+        if (queued)
+        {
+            queueReady.notify_one();
+        }
+        else
+        {
+            rejected++;
+            replyError(pending, SolveStatus::OVERLOADED, "queue full");
+        }
+    }
+    // after an oversized or cut off frame the stream cannot be resynced,
+    // so the client gets end of file now. After an orderly close the
+    // client may still wait for replies; the socket closes once the
+    // last pending request lets go of the connection
+    if (!closed)
+    {
+        ::shutdown(connection->fd, SHUT_RDWR);
+    }
+    connection.reset();
+    reader->finished = true;
+}
+
+void SolveServer::dispatchLoop()
+{
+    std::vector<Pending> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(queueLock);
+            queueReady.wait(guard, [this] { return stopping || !queue.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+            size_t count = std::min(queue.size(), maxBatch);
+            for (size_t i = 0; i < count; i++)
+            {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            inFlight = count;
+        }
+        solveBatch(batch);
+        batches++;
+        batchedRequests += batch.size();
+        inFlight = 0;
+        batch.clear();
+    }
+}
+
+void SolveServer::solveBatch( std::vector<Pending> &batch )
+{
+    PROFILE_SCOPE("server.batch");
+    PROFILE_COUNTER("server.batch_size", (double)batch.size());
+
+    // every case gets a fresh model, like a line of the batch tool
+    std::vector<FiniteElementModel> models(batch.size());
+    std::vector<char> valid(batch.size(), 0);
+    pool->parallelFor(batch.size(), [&](size_t i, int)
+    {
+        std::string error;
+        try
+        {
+            valid[i] = applyCasePairs(batch[i].request.pairs, models[i], error);
+        }
+        catch (const std::exception &e)
+        {
+            valid[i] = false;
+            error = e.what();
+        }
+        if (!valid[i])
+        {
+            replyError(batch[i], SolveStatus::BAD_REQUEST, error);
+        }
+    });
+
+    // constant k and q, linear elements, uniform mesh and a direct
+    // solver is exactly what RodBatchSolver does; group those by node
+    // count and coordinate system, the rest are solved one by one
+    std::map< std::pair<int, int>, std::vector<size_t> > groups;
+    std::vector< std::vector<size_t> > tasks;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (!valid[i])
+        {
+            continue;
+        }
+        const FiniteElementModel &m = models[i];
+        bool rod = m.modelElement == ElementType::LINEAR && m.layers.empty()
+            && m.conductivityCurve.empty() && m.adaptiveTolerance <= 0.0 && m.param.n >= 3
+            && (m.modelSolver == SolverType::BANDED || m.modelSolver == SolverType::SPARSE_LDLT);
+        if (rod)
+        {
+            groups[std::make_pair(m.param.n, (int)m.modelCoord)].push_back(i);
+        }
+        else
+        {
+            tasks.push_back(std::vector<size_t>(1, i));
+        }
+    }
+    size_t singles = tasks.size();
+    for (auto &group : groups)
+    {
+        // split large groups so every worker gets a share
+        size_t chunk = std::max<size_t>(RodBatchSolver::laneBlock,
+                                        group.second.size()/pool->size() + 1);
+        for (size_t first = 0; first < group.second.size(); first += chunk)
+        {
+            size_t last = std::min(first + chunk, group.second.size());
+            tasks.push_back(std::vector<size_t>(group.second.begin() + first,
+                                                group.second.begin() + last));
+        }
+    }
+
+    // a case that throws (e.g. runs out of memory) is answered with an
+    // error; an exception escaping a pool worker would end the process
+    // and with it every other client's requests
+    pool->parallelFor(tasks.size(), [&](size_t t, int)
+    {
+        const std::vector<size_t> &members = tasks[t];
+        size_t answered = 0;
+        try
+        {
+            solveTask(batch, models, members, t >= singles, answered);
+        }
+        catch (const std::exception &e)
+        {
+            for (size_t r = answered; r < members.size(); r++)
+            {
+                replyError(batch[members[r]], SolveStatus::BAD_REQUEST,
+                           std::string("solve failed: ") + e.what());
+            }
+        }
+    });
+}
+
+void SolveServer::solveTask( std::vector<Pending> &batch, std::vector<FiniteElementModel> &models,
+                             const std::vector<size_t> &members, bool grouped, size_t &answered )
+{
+    if (!grouped)
+    {
+        FiniteElementModel &model = models[members[0]];
+        FiniteElementSolution sol = model.findNodalSolution();
+        reply(batch[members[0]], sol, model);
+        answered = 1;
+        return;
+    }
+
+    size_t count = members.size();
+    RodBatchInputs inputs;
+    inputs.a.resize(count);
+    inputs.b.resize(count);
+    inputs.bc_a.resize(count);
+    inputs.bc_b.resize(count);
+    inputs.k.resize(count);
+    inputs.q.resize(count);
+    for (size_t r = 0; r < count; r++)
+    {
+        const FiniteElementParameters &p = models[members[r]].param;
+        inputs.a(r) = p.a;
+        inputs.b(r) = p.b;
+        inputs.bc_a(r) = p.bc_a;
+        inputs.bc_b(r) = p.bc_b;
+        inputs.k(r) = p.k;
+        inputs.q(r) = p.q;
+    }
+    RodBatchSolver rods;
+    rods.set_n(models[members[0]].param.n);
+    rods.set_coord(models[members[0]].modelCoord);
+    rods.solve(inputs);
+    rodBatched += count;
+    for (size_t r = 0; r < count; r++)
+    {
+        FiniteElementSolution sol = rods.solution(r);
+        reply(batch[members[r]], sol, models[members[r]]);
+        answered = r + 1;
+    }
+}
+
+void SolveServer::reply( Pending &pending, const FiniteElementSolution &sol,
+                         FiniteElementModel &model )
+{
+    if (!sol.nodalSolution.allFinite() || !sol.boundaryValues.allFinite())
+    {
+        // e.g. a heat generation so large that T overflows
+        replyError(pending, SolveStatus::BAD_REQUEST, "solution is not finite");
+        return;
+    }
+    FiniteElementSolution shown = sol;
+    model.convertToDisplayUnits(shown);
+    SolveStatus status = sol.stats.converged ? SolveStatus::OK : SolveStatus::NOT_CONVERGED;
+    double seconds = std::chrono::duration<double>(Clock::now() - pending.received).count();
+    {
+        std::lock_guard<std::mutex> guard(pending.connection->writeLock);
+        SolveProtocol::writeSolution(pending.connection->fd, pending.request.reply, pending.request.id,
+                                     status, shown, model.get_unit_sys(), model.get_coord(),
+                                     model.get_element(), seconds);
+    }
+    completed++;
+    recordLatency(pending.received);
+}
+
+void SolveServer::replyError( Pending &pending, SolveStatus status, const std::string &message )
+{
+    {
+        std::lock_guard<std::mutex> guard(pending.connection->writeLock);
+        SolveProtocol::writeError(pending.connection->fd, pending.request.reply,
+                                  pending.request.id, status, message);
+    }
+    if (status == SolveStatus::BAD_REQUEST)
+    {
+        failed++;
+    }
+}
+
+void SolveServer::recordLatency( Clock::time_point received )
+{
+    double seconds = std::chrono::duration<double>(Clock::now() - received).count();
+    std::lock_guard<std::mutex> guard(latencyLock);
+    if (latencies.size() < latencyWindow)
+    {
+        latencies.push_back(seconds);
+    }
+    else
+    {
+        latencies[latencyNext] = seconds;
+    }
+    latencyNext = (latencyNext + 1) % latencyWindow;
+}
+
+SolveServerStats SolveServer::stats()
+{
+    SolveServerStats s;
+    {
+        std::lock_guard<std::mutex> guard(queueLock);
+        s.queueDepth = queue.size();
+    }
+    {
+        std::lock_guard<std::mutex> guard(readersLock);
+        s.connections = 0;
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            s.connections += readers[i]->finished ? 0 : 1;
+        }
+    }
+    s.inFlight = inFlight;
+    s.received = received;
+    s.completed = completed;
+    s.failed = failed;
+    s.rejected = rejected;
+    s.batches = batches;
+    s.rodBatched = rodBatched;
+    s.meanBatch = (s.batches > 0) ? (double)batchedRequests/s.batches : 0.0;
+
+    std::vector<double> sorted;
+    {
+        std::lock_guard<std::mutex> guard(latencyLock);
+        sorted = latencies;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    s.latencySamples = sorted.size();
+    // nearest rank percentiles
+    auto percentile = [&sorted](double p)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = (size_t)(p*sorted.size());
+        return sorted[std::min(rank, sorted.size() - 1)];
+    };
+    s.latencyP50 = percentile(0.50);
+    s.latencyP90 = percentile(0.90);
+    s.latencyP99 = percentile(0.99);
+    s.latencyMax = sorted.empty() ? 0.0 : sorted.back();
+    return s;
+}
+
+std::string SolveServer::statsJson()
+{
+    SolveServerStats s = stats();
+    char text[640];
+    std::snprintf(text, sizeof(text),
+                  "{\"status\": \"ok\", \"queue_depth\": %zu, \"in_flight\": %zu, \"connections\": %zu, "
+                  "\"received\": %llu, \"completed\": %llu, \"failed\": %llu, \"rejected\": %llu, "
+                  "\"batches\": %llu, \"mean_batch\": %.2f, \"rod_batched\": %llu, "
+                  "\"latency\": {\"samples\": %zu, \"p50\": %.6e, \"p90\": %.6e, \"p99\": %.6e, \"max\": %.6e}}",
+                  s.queueDepth, s.inFlight, s.connections,
+                  (unsigned long long)s.received, (unsigned long long)s.completed,
+                  (unsigned long long)s.failed, (unsigned long long)s.rejected,
+                  (unsigned long long)s.batches, s.meanBatch, (unsigned long long)s.rodBatched,
+                  s.latencySamples, s.latencyP50, s.latencyP90, s.latencyP99, s.latencyMax);
+    return text;
+}
@@ -0,0 +1,168 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef SOLVESERVER_H
+#define SOLVESERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "solveprotocol.h"
+#include "threadpool.h"
+
+// counters since the server started; latencies are over the most
+// recent replies, from reading a request to writing its reply
+typedef struct
+{
+    size_t queueDepth; // requests waiting for the next batch
+    size_t inFlight; // requests in the batch being solved
+    size_t connections;
+    uint64_t received;
+    uint64_t completed; // replies with values
+    uint64_t failed; // bad requests
+    uint64_t rejected; // refused because the queue was full
+    uint64_t batches;
+    uint64_t rodBatched; // solved together by a RodBatchSolver
+    double meanBatch; // requests per batch
+    size_t latencySamples;
+    double latencyP50; // seconds
+    double latencyP90;
+    double latencyP99;
+    double latencyMax;
+}
+SolveServerStats;
+
+// long-running solve service on a Unix domain socket, see
+// solveprotocol.h for the wire format. Every connection has a reader
+// thread that decodes frames into a shared queue. A dispatcher thread
+// takes everything queued, up to the batch limit, and solves it on a
+// thread pool, so the batches grow with the load. Within a batch,
+// constant property cases with linear elements that share the node
+// count and coordinate system are solved together by a RodBatchSolver;
+// every other case gets its own FiniteElementModel. Each reply is
+// written by the worker that solved it, so replies on a connection can
+// come back out of order and are matched to requests by id.
+class SolveServer
+{
+
+public:
+    SolveServer();
+    ~SolveServer();
+
+    void set_socket_path( const std::string &path );
+    void set_threads( int new_threads ); // 0 = one per core
+    void set_max_batch( int new_max );
+    void set_max_queue( int new_max ); // later requests get OVERLOADED
+
+    // binds and starts serving in the background; false and a message
+    // if the socket cannot be set up or is used by a running server
+    bool start( std::string &error );
+    // stops accepting, closes every connection and drops queued
+    // requests; removes the socket file
+    void stop();
+
+    SolveServerStats stats();
+    std::string statsJson();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // closed when the reader and the last pending reply let go of it
+    typedef struct Connection
+    {
+        int fd;
+        std::mutex writeLock; // one reply at a time
+        ~Connection();
+    }
+    Connection;
+
+    // the thread reading one connection; it only holds a weak reference,
+    // so a finished reader does not keep the socket open
+    typedef struct
+    {
+        std::thread thread;
+        std::weak_ptr<Connection> connection;
+        std::atomic<bool> finished;
+    }
+    Reader;
+
+    typedef struct
+    {
+        std::shared_ptr<Connection> connection;
+        SolveRequest request;
+        Clock::time_point received;
+    }
+    Pending;
+
+    void acceptLoop();
+    void readLoop( std::shared_ptr<Connection> connection, Reader *reader );
+    void dispatchLoop();
+    void solveBatch( std::vector<Pending> &batch );
+    // one single case, or a group for RodBatchSolver; answered counts
+    // the members replied to, for the error replies if it throws
+    void solveTask( std::vector<Pending> &batch, std::vector<FiniteElementModel> &models,
+                    const std::vector<size_t> &members, bool grouped, size_t &answered );
+    void reply( Pending &pending, const FiniteElementSolution &sol, FiniteElementModel &model );
+    void replyError( Pending &pending, SolveStatus status, const std::string &message );
+    void recordLatency( Clock::time_point received );
+
+    std::string socketPath;
+    int threads;
+    size_t maxBatch;
+    size_t maxQueue;
+
+    int listenFd;
+    std::atomic<bool> stopping;
+    std::unique_ptr<ThreadPool> pool;
+    std::thread acceptor;
+    std::thread dispatcher;
+
+    std::mutex readersLock;
+    std::vector< std::unique_ptr<Reader> > readers;
+
+    std::mutex queueLock;
+    std::condition_variable queueReady;
+    std::deque<Pending> queue;
+    std::atomic<size_t> inFlight;
+
+    std::atomic<uint64_t> received;
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> batchedRequests;
+    std::atomic<uint64_t> rodBatched;
+
+    static const size_t latencyWindow = 4096;
+    std::mutex latencyLock;
+    std::vector<double> latencies; // ring of the last latencyWindow
+    size_t latencyNext;
+};
+
+#endif // SOLVESERVER_H
@@ -0,0 +1,147 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "sparseassembler.h"
+
+SparseAssembler::SparseAssembler()
+{
+    reset(0);
+}
+
+void SparseAssembler::reset( int ndofs )
+{
+    equation.assign(ndofs, 0);
+    fixedValues = VectorXd::Zero(ndofs);
+    freeCount = ndofs;
+    numbered = false;
+
+    globalEntries.clear();
+    reducedEntries.clear();
+    Fr.resize(0);
+    K.resize(0,0);
+    Kr.resize(0,0);
+}
+
+void SparseAssembler::reserve( int entriesPerElement, int numElements )
+{
+    globalEntries.reserve( (size_t)entriesPerElement*numElements );
+    reducedEntries.reserve( (size_t)entriesPerElement*numElements );
+}
+
+void SparseAssembler::setDirichlet( int dof, double value )
+{
+    equation[dof] = -1;
+    fixedValues(dof) = value;
+    numbered = false;
+}
+
+void SparseAssembler::numberEquations()
+{
+    // free dofs keep their relative order so the reduced matrix
+    // has the same bandwidth as the global one
+    freeCount = 0;
+    for (size_t i = 0; i < equation.size(); i++)
+    {
+        if (equation[i] >= 0)
+        {
+            equation[i] = freeCount++;
+        }
+    }
+    Fr = VectorXd::Zero(freeCount);
+    numbered = true;
+}
+
+void SparseAssembler::addElement( const int *dofs,
+                                  const Eigen::Ref<const MatrixXd> &ke,
+                                  const Eigen::Ref<const VectorXd> &fe )
+{
+    if (!numbered)
+    {
+        numberEquations();
+    }
+
+    int nen = fe.size();
+    for (int i = 0; i < nen; i++)
+    {
+        int gi = dofs[i];
+        int ri = equation[gi];
+        if (ri >= 0)
+        {
+            Fr(ri) += fe(i);
+        }
+        for (int j = 0; j < nen; j++)
+        {
+            int gj = dofs[j];
+            int rj = equation[gj];
+            globalEntries.push_back( TripletXd(gi, gj, ke(i,j)) );
+            if (ri < 0)
+            {
+                continue;
+            }
+            if (rj >= 0)
+            {
+                reducedEntries.push_back( TripletXd(ri, rj, ke(i,j)) );
+            }
+            else
+            {
+                // subtract off known boundary value
+                Fr(ri) -= ke(i,j)*fixedValues(gj);
+            }
+        }
+    }
+}
+
+void SparseAssembler::finalize()
+{
+    if (!numbered)
+    {
+        numberEquations();
+    }
+
+    int n = equation.size();
+    K.resize(n,n);
+    K.setFromTriplets( globalEntries.begin(), globalEntries.end() );
+    Kr.resize(freeCount,freeCount);
+    Kr.setFromTriplets( reducedEntries.begin(), reducedEntries.end() );
+
+    // triplets are not needed once compressed
+    std::vector<TripletXd>().swap(globalEntries);
+    std::vector<TripletXd>().swap(reducedEntries);
+}
+
+int SparseAssembler::numFreeDofs() const
+{
+    return freeCount;
+}
+
+const SparseMatrixXd &SparseAssembler::globalMatrix() const
+{
+    return K;
+}
+
+const SparseMatrixXd &SparseAssembler::reducedMatrix() const
+{
+    return Kr;
+}
+
+const VectorXd &SparseAssembler::reducedLoad() const
+{
+    return Fr;
+}
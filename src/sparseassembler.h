@@ -0,0 +1,71 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef SPARSEASSEMBLER_H
+#define SPARSEASSEMBLER_H
+
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Sparse>
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+typedef Eigen::SparseMatrix<double> SparseMatrixXd;
+typedef Eigen::Triplet<double> TripletXd;
+
+// collects element matrices as triplets and builds both the full
+// global matrix (used for the boundary fluxes afterwards) and the
+// reduced system for the free degrees of freedom, with the known
+// Dirichlet values already moved to the right hand side
+class SparseAssembler
+{
+
+public:
+    SparseAssembler();
+    void reset( int ndofs ); // all dofs free, no entries
+    void reserve( int entriesPerElement, int numElements );
+    void setDirichlet( int dof, double value ); // call before adding elements
+    void addElement( const int *dofs,
+                     const Eigen::Ref<const MatrixXd> &ke,
+                     const Eigen::Ref<const VectorXd> &fe );
+    void finalize(); // compress triplets into sparse matrices
+
+    int numFreeDofs() const;
+    const SparseMatrixXd &globalMatrix() const;
+    const SparseMatrixXd &reducedMatrix() const;
+    const VectorXd &reducedLoad() const;
+
+private:
+    void numberEquations();
+
+    std::vector<int> equation; // dof -> row in reduced system, or -1
+    VectorXd fixedValues;
+    int freeCount;
+    bool numbered; // equation numbers are up to date
+
+    std::vector<TripletXd> globalEntries;
+    std::vector<TripletXd> reducedEntries;
+    VectorXd Fr; // reduced load vector
+
+    SparseMatrixXd K;
+    SparseMatrixXd Kr;
+};
+
+#endif // SPARSEASSEMBLER_H
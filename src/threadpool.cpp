@@ -0,0 +1,206 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+
+static thread_local int workerIndex = -1;
+static thread_local const ThreadPool *workerPool = nullptr;
+
+ThreadPool::ThreadPool( int numThreads )
+{
+    if (numThreads <= 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queued = 0;
+    nextQueue = 0;
+    stopping = false;
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        queues.push_back( std::unique_ptr<WorkerQueue>(new WorkerQueue) );
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers.push_back( std::thread(&ThreadPool::workerLoop, this, i) );
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+int ThreadPool::size() const
+{
+    return workers.size();
+}
+
+int ThreadPool::currentWorker()
+{
+    return workerIndex;
+}
+
+void ThreadPool::submit( std::function<void()> task )
+{
+    // tasks submitted from a worker go to its own deque, so nested
+    // work stays local until someone else runs out and steals it
+    size_t target;
+    if (workerPool == this && workerIndex >= 0)
+    {
+        target = workerIndex;
+    }
+    else
+    {
+        target = nextQueue.fetch_add(1) % queues.size();
+    }
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back( std::move(task) );
+    }
+    {
+        // take the lock so a worker about to sleep cannot miss this
+        std::lock_guard<std::mutex> guard(sleepLock);
+    }
+    wakeUp.notify_one();
+}
+
+bool ThreadPool::runOneTask( int index )
+{
+    std::function<void()> task;
+    int count = queues.size();
+
+    // newest task from our own deque
+    if (index >= 0)
+    {
+        WorkerQueue &own = *queues[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    // otherwise the oldest task of some other worker
+    for (int i = 1; !task && i <= count; i++)
+    {
+        int victim = ((index < 0 ? 0 : index) + i) % count;
+        WorkerQueue &other = *queues[victim];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if (!other.tasks.empty())
+        {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+        }
+    }
+
+    if (!task)
+    {
+        return false;
+    }
+    queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop( int index )
+{
+    workerIndex = index;
+    workerPool = this;
+    for (;;)
+    {
+        if (runOneTask(index))
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wakeUp.wait(guard, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallelFor( size_t count,
+                              const std::function<void(size_t index, int worker)> &body )
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // a few chunks per worker so stealing can even out uneven solves
+    size_t chunks = std::min(count, (size_t)queues.size()*4);
+    size_t chunkSize = (count + chunks - 1)/chunks;
+    chunks = (count + chunkSize - 1)/chunkSize;
+
+    std::atomic<size_t> remaining(chunks);
+    std::mutex doneLock;
+    std::condition_variable done;
+
+    for (size_t c = 0; c < chunks; c++)
+    {
+        size_t begin = c*chunkSize;
+        size_t end = std::min(count, begin + chunkSize);
+        submit( [&, begin, end]()
+        {
+            int worker = workerIndex;
+            for (size_t i = begin; i < end; i++)
+            {
+                body(i, worker);
+            }
+            std::lock_guard<std::mutex> guard(doneLock);
+            if (--remaining == 0)
+            {
+                done.notify_all();
+            }
+        });
+    }
+
+    // a worker calling in helps out instead of blocking its slot,
+    // an outside thread just waits for the chunks to finish
+    int self = (workerPool == this) ? workerIndex : -1;
+    while (remaining.load() > 0)
+    {
+        if (self >= 0 && runOneTask(self))
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(doneLock);
+        done.wait_for(guard, std::chrono::milliseconds(1),
+                      [&remaining] { return remaining.load() == 0; });
+    }
+    // the last chunk may still hold the lock after its decrement
+    std::lock_guard<std::mutex> guard(doneLock);
+}
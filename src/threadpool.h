@@ -0,0 +1,76 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed-size pool of worker threads, each with its own task deque;
+// a worker pops its own newest task first and, when it runs dry,
+// steals the oldest task from another worker
+class ThreadPool
+{
+
+public:
+    explicit ThreadPool( int numThreads = 0 ); // 0 = one per core
+    ~ThreadPool();
+
+    int size() const;
+    void submit( std::function<void()> task );
+
+    // run body(index, worker) for index in [0, count), split into
+    // chunks across the workers; returns once every index is done.
+    // worker is in [0, size()) and can select per-thread state.
+    void parallelFor( size_t count,
+                      const std::function<void(size_t index, int worker)> &body );
+
+    // index of the pool worker running the caller, -1 for other threads
+    static int currentWorker();
+
+private:
+    typedef struct
+    {
+        std::mutex lock;
+        std::deque< std::function<void()> > tasks;
+    }
+    WorkerQueue;
+
+    void workerLoop( int index );
+    bool runOneTask( int index ); // own queue first, then steal
+
+    std::vector< std::unique_ptr<WorkerQueue> > queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued; // tasks sitting in the deques
+    std::atomic<size_t> nextQueue; // round robin for outside submits
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+    bool stopping;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,333 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "transientsolver.h"
+#include "profiler.h"
+
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+TransientSolver::TransientSolver( const FiniteElementModel &base )
+    : model(base)
+{
+    scheme = TimeScheme::CRANK_NICOLSON;
+    dt = 1.0;
+    stride = 1;
+
+    factored = false;
+    factoredStep = 0.0;
+    factoredScheme = scheme;
+    factorizations = 0;
+    if (model.has_conductivity_curve())
+    {
+        error = "k(T) is not supported in transient runs";
+    }
+
+    switch (model.get_element())
+    {
+    case ElementType::QUADRATIC:
+        assemble<2>();
+        break;
+    case ElementType::CUBIC:
+        assemble<3>();
+        break;
+    default:
+        assemble<1>();
+        break;
+    }
+    reset();
+}
+
+template<int Order>
+void TransientSolver::assemble()
+{
+    typedef LagrangeElement<Order> Element;
+    typedef Eigen::Matrix<double, Element::nodes, Element::nodes, Eigen::RowMajor> ElementMatrix;
+    typedef Eigen::Matrix<double, Element::nodes, 1> ElementVector;
+    constexpr std::array<double, Element::nodes*Element::nodes> Kref = Element::stiffness();
+    constexpr std::array<double, Element::nodes*Element::nodes> Mref = Element::mass();
+    constexpr std::array<double, Element::nodes> Fref = Element::load();
+
+    const FiniteElementParameters &p = model.param;
+    VectorXd mesh = model.uniformMesh();
+    VectorXd kElem, qElem;
+    model.elementMaterials(mesh, kElem, qElem);
+    int ne = mesh.size();
+    VectorXd c(ne);
+    model.elementStiffness(mesh, kElem, c);
+    int dofs = ne*Order + 1;
+    bc_a = p.bc_a;
+    bc_b = p.bc_b;
+
+    // the boundary values never change, so the mass matrix adds
+    // nothing to the right hand side and only its free block is used
+    SparseAssembler stiffness;
+    SparseAssembler mass;
+    stiffness.reset(dofs);
+    mass.reset(dofs);
+    stiffness.reserve(Element::nodes*Element::nodes, ne);
+    mass.reserve(Element::nodes*Element::nodes, ne);
+    stiffness.setDirichlet(0, bc_a);
+    stiffness.setDirichlet(dofs-1, bc_b);
+    mass.setDirichlet(0, bc_a);
+    mass.setDirichlet(dofs-1, bc_b);
+
+    Eigen::Matrix<double, Element::nodes, Element::nodes> ke;
+    Eigen::Matrix<double, Element::nodes, Element::nodes> me;
+    ElementVector fe;
+    ElementVector noLoad = ElementVector::Zero();
+    int elemDofs[Element::nodes];
+    xvals.resize(dofs);
+    double x = p.a;
+    for (int e = 0; e < ne; e++)
+    {
+        double h = mesh(e);
+        ke = c(e)*Eigen::Map<const ElementMatrix>(Kref.data());
+        me = (p.rho*p.cp*h)*Eigen::Map<const ElementMatrix>(Mref.data());
+        fe = (qElem(e)*h)*Eigen::Map<const ElementVector>(Fref.data());
+        for (int j = 0; j < Element::nodes; j++)
+        {
+            elemDofs[j] = e*Order + j;
+        }
+        for (int j = 0; j < Order; j++)
+        {
+            xvals(e*Order + j) = x + j*h/Order;
+        }
+        x = x + h;
+        stiffness.addElement(elemDofs, ke, fe);
+        mass.addElement(elemDofs, me, noLoad);
+    }
+    xvals(dofs-1) = p.b;
+    stiffness.finalize();
+    mass.finalize();
+
+    K = stiffness.reducedMatrix();
+    M = mass.reducedMatrix();
+    F = stiffness.reducedLoad();
+    banded = (Order == 1);
+}
+
+void TransientSolver::set_scheme( TimeScheme new_scheme )
+{
+    scheme = new_scheme;
+}
+
+void TransientSolver::set_time_step( double new_dt )
+{
+    dt = new_dt;
+}
+
+void TransientSolver::set_stride( int new_stride )
+{
+    stride = (new_stride > 0) ? new_stride : 1;
+}
+
+void TransientSolver::set_sink( SnapshotSink new_sink )
+{
+    sink = new_sink;
+}
+
+void TransientSolver::reset()
+{
+    interior = VectorXd::Constant( M.rows(), model.param.t0 );
+    work.resize( M.rows() );
+    nodes.resize( xvals.size() );
+    step = 0;
+    time = 0.0;
+}
+
+void TransientSolver::factorize()
+{
+    double theta = (scheme == TimeScheme::CRANK_NICOLSON) ? 0.5 : 1.0;
+    SparseMatrixXd A = M + (theta*dt)*K;
+    SparseMatrixXd B = M - ((1.0 - theta)*dt)*K;
+    dtLoad = dt*F;
+
+    if (banded)
+    {
+        // pull the three diagonals out once, the steps then run on
+        // plain vectors only
+        int m = A.rows();
+        int offdiag = (m > 0) ? m-1 : 0;
+        VectorXd lower(offdiag);
+        VectorXd diag(m);
+        VectorXd upper(offdiag);
+        rightLower.resize(offdiag);
+        rightDiag.resize(m);
+        rightUpper.resize(offdiag);
+        for (int i = 0; i < m; i++)
+        {
+            diag(i) = A.coeff(i,i);
+            rightDiag(i) = B.coeff(i,i);
+            if (i+1 < m)
+            {
+                lower(i) = A.coeff(i+1,i);
+                upper(i) = A.coeff(i,i+1);
+                rightLower(i) = B.coeff(i+1,i);
+                rightUpper(i) = B.coeff(i,i+1);
+            }
+        }
+        tridiagonal.factorize(lower, diag, upper);
+    }
+    else
+    {
+        rightMatrix = B;
+        ldlt.compute(A);
+    }
+
+    factored = true;
+    factoredStep = dt;
+    factoredScheme = scheme;
+    factorizations++;
+}
+
+TransientStatistics TransientSolver::run( int count )
+{
+    TransientStatistics stats;
+    stats.steps = 0;
+    stats.cancelled = false;
+    stats.factorizationTime = 0.0;
+    if (!error.empty())
+    {
+        stats.time = time;
+        stats.factorizations = factorizations;
+        stats.stepTime = 0.0;
+        return stats;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    if (!factored || factoredStep != dt || factoredScheme != scheme)
+    {
+        factorize();
+        stats.factorizationTime = secondsSince(t0);
+        PROFILE_INTERVAL("transient.factorization", t0);
+    }
+
+    t0 = Clock::now();
+    if (step == 0)
+    {
+        emit();
+    }
+
+    int m = interior.size();
+    double start = time;
+    for (int s = 0; s < count; s++)
+    {
+        // the check may take a lock, so only poll it now and then
+        if ((s & 1023) == 0 && model.isCancelled())
+        {
+            stats.cancelled = true;
+            break;
+        }
+
+        if (m > 0 && banded)
+        {
+            // work = B*T + dt*F, then solve A*T1 = work in place
+            const double *l = rightLower.data();
+            const double *d = rightDiag.data();
+            const double *u = rightUpper.data();
+            const double *f = dtLoad.data();
+            const double *x = interior.data();
+            double *r = work.data();
+            if (m == 1)
+            {
+                r[0] = d[0]*x[0] + f[0];
+            }
+            else
+            {
+                r[0] = d[0]*x[0] + u[0]*x[1] + f[0];
+                for (int i = 1; i < m-1; i++)
+                {
+                    r[i] = l[i-1]*x[i-1] + d[i]*x[i] + u[i]*x[i+1] + f[i];
+                }
+                r[m-1] = l[m-2]*x[m-2] + d[m-1]*x[m-1] + f[m-1];
+            }
+            tridiagonal.solveInPlace(work);
+            interior.swap(work);
+        }
+        else if (m > 0)
+        {
+            work.noalias() = rightMatrix*interior;
+            work += dtLoad;
+            interior = ldlt.solve(work);
+        }
+
+        step++;
+        stats.steps++;
+        time = start + stats.steps*dt;
+        if (step % stride == 0)
+        {
+            emit();
+        }
+    }
+    if (stats.steps > 0 && step % stride != 0)
+    {
+        emit();
+    }
+
+    stats.stepTime = secondsSince(t0);
+    PROFILE_INTERVAL("transient.steps", t0);
+    stats.time = time;
+    stats.factorizations = factorizations;
+    return stats;
+}
+
+void TransientSolver::emit()
+{
+    if (sink)
+    {
+        sink( step, time, get_nodal_solution() );
+    }
+}
+
+const std::string &TransientSolver::get_error() const
+{
+    return error;
+}
+
+int TransientSolver::get_step() const
+{
+    return step;
+}
+
+double TransientSolver::get_time() const
+{
+    return time;
+}
+
+const VectorXd &TransientSolver::get_x_vals() const
+{
+    return xvals;
+}
+
+const VectorXd &TransientSolver::get_nodal_solution()
+{
+    int n = nodes.size();
+    nodes(0) = bc_a;
+    nodes.segment(1, n-2) = interior;
+    nodes(n-1) = bc_b;
+    return nodes;
+}
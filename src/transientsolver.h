@@ -0,0 +1,131 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef TRANSIENTSOLVER_H
+#define TRANSIENTSOLVER_H
+
+#include <functional>
+#include <string>
+
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/SparseCholesky>
+
+#include "finiteelementmodel.h"
+#include "sparseassembler.h"
+#include "tridiagonalsolver.h"
+
+// time integration schemes, both from the theta family
+enum class TimeScheme
+{
+    BACKWARD_EULER, CRANK_NICOLSON
+};
+
+// receives a time level in SI with every node included; the vector is
+// only valid during the call, so copy out whatever has to be kept
+typedef std::function<void(int step, double time, const VectorXd &nodalSolution)> SnapshotSink;
+
+// what the last call to run() did
+typedef struct
+{
+    int steps; // steps taken, fewer than asked if cancelled
+    double time; // simulated time reached, s
+    int factorizations; // total since construction
+    double factorizationTime; // s
+    double stepTime; // s, including the time spent in the sink
+    bool cancelled;
+}
+TransientStatistics;
+
+// integrates rho*cp*Tt = k*T'' + q on the uniform mesh of a model,
+// starting from a uniform temperature with the boundary values held
+// fixed. With the mass matrix M next to the stiffness K every step of
+// the theta scheme solves
+//   (M + theta*dt*K) T1 = (M - (1-theta)*dt*K) T0 + dt*F
+// The left matrix is factorized once per step size and scheme and then
+// reused, so a step is one banded multiply and one pair of triangular
+// solves. Linear elements keep everything tridiagonal, higher orders
+// use a sparse LDLT factorization. The matrices are built for a
+// constant k, so a model with a k(T) curve is refused: get_error()
+// says why and run() takes no steps.
+class TransientSolver
+{
+
+public:
+    TransientSolver( const FiniteElementModel &base );
+
+    void set_scheme( TimeScheme new_scheme );
+    void set_time_step( double new_dt ); // s, in every unit system
+    // the sink gets the initial state, every stride-th step and the
+    // last step of each run
+    void set_stride( int new_stride );
+    void set_sink( SnapshotSink new_sink );
+
+    void reset(); // back to the initial temperature at time 0
+    TransientStatistics run( int count ); // continues from the current state
+
+    const std::string &get_error() const; // empty if the model can be integrated
+    int get_step() const;
+    double get_time() const;
+    const VectorXd &get_x_vals() const; // SI
+    const VectorXd &get_nodal_solution(); // SI, all nodes
+
+private:
+    template<int Order> void assemble();
+    void factorize();
+    void emit();
+
+    FiniteElementModel model;
+    std::string error;
+    TimeScheme scheme;
+    double dt;
+    int stride;
+    SnapshotSink sink;
+
+    // operators on the free nodes, boundary terms folded into F
+    SparseMatrixXd M;
+    SparseMatrixXd K;
+    VectorXd F;
+    double bc_a;
+    double bc_b;
+    bool banded; // linear elements, M and K tridiagonal
+
+    // factorization for factoredStep and factoredScheme
+    bool factored;
+    double factoredStep;
+    TimeScheme factoredScheme;
+    int factorizations;
+    TridiagonalSolver tridiagonal;
+    VectorXd rightLower; // right hand matrix in banded storage,
+    VectorXd rightDiag; // laid out like TridiagonalSystem
+    VectorXd rightUpper;
+    SparseMatrixXd rightMatrix; // same for higher orders
+    VectorXd dtLoad;
+    Eigen::SimplicialLDLT<SparseMatrixXd> ldlt;
+
+    VectorXd xvals;
+    VectorXd interior; // current temperatures of the free nodes
+    VectorXd work;
+    VectorXd nodes; // full vector, filled on demand
+    int step;
+    double time;
+};
+
+#endif // TRANSIENTSOLVER_H
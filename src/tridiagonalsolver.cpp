@@ -0,0 +1,110 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "tridiagonalsolver.h"
+
+VectorXd tridiagonalMultiply( const TridiagonalSystem &sys, const VectorXd &x )
+{
+    int n = sys.diag.size();
+    VectorXd y = sys.diag.cwiseProduct(x);
+    if (n > 1)
+    {
+        // y(i) += K(i,i+1)*x(i+1) and y(i+1) += K(i+1,i)*x(i)
+        y.head(n-1) += sys.upper.cwiseProduct( x.tail(n-1) );
+        y.tail(n-1) += sys.lower.cwiseProduct( x.head(n-1) );
+    }
+    return y;
+}
+
+TridiagonalSolver::TridiagonalSolver()
+{
+
+}
+
+void TridiagonalSolver::factorize( const Eigen::Ref<const VectorXd> &lower,
+                                   const Eigen::Ref<const VectorXd> &diag,
+                                   const Eigen::Ref<const VectorXd> &upper )
+{
+    // K = L*U with L unit lower bidiagonal and U upper bidiagonal;
+    // no pivoting is needed since the FEM matrices are diagonally dominant
+    int n = diag.size();
+    multipliers.resize( (n > 0) ? n-1 : 0 );
+    invPivots.resize(n);
+    upperFactor = upper;
+    if (n == 0)
+    {
+        return;
+    }
+
+    double pivot = diag(0);
+    invPivots(0) = 1.0/pivot;
+    for (int i = 1; i < n; i++)
+    {
+        double m = lower(i-1)*invPivots(i-1);
+        multipliers(i-1) = m;
+        pivot = diag(i) - m*upper(i-1);
+        invPivots(i) = 1.0/pivot;
+    }
+}
+
+void TridiagonalSolver::solveInPlace( Eigen::Ref<VectorXd> rhs ) const
+{
+    int n = invPivots.size();
+    if (n == 0)
+    {
+        return;
+    }
+
+    // both sweeps carry the previous value in a register, so the only
+    // dependency from one row to the next is the arithmetic itself and
+    // repeated solves (time stepping) run at streaming speed
+    double *r = rhs.data();
+    const double *m = multipliers.data();
+    const double *u = upperFactor.data();
+    const double *p = invPivots.data();
+
+    // forward substitution with L
+    double prev = r[0];
+    for (int i = 1; i < n; i++)
+    {
+        prev = r[i] - m[i-1]*prev;
+        r[i] = prev;
+    }
+    // back substitution with U
+    prev = prev*p[n-1];
+    r[n-1] = prev;
+    for (int i = n-2; i >= 0; i--)
+    {
+        prev = (r[i] - u[i]*prev)*p[i];
+        r[i] = prev;
+    }
+}
+
+VectorXd TridiagonalSolver::solve( const Eigen::Ref<const VectorXd> &rhs ) const
+{
+    VectorXd x = rhs;
+    solveInPlace(x);
+    return x;
+}
+
+int TridiagonalSolver::size() const
+{
+    return invPivots.size();
+}
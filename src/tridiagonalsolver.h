@@ -0,0 +1,62 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef TRIDIAGONALSOLVER_H
+#define TRIDIAGONALSOLVER_H
+
+#include <eigen3/Eigen/Dense>
+using Eigen::VectorXd;
+
+// banded storage for a global system with only three non-zero
+// diagonals, as produced by 1D linear elements:
+//   lower(i) = K(i+1,i), diag(i) = K(i,i), upper(i) = K(i,i+1)
+typedef struct
+{
+    VectorXd lower; // sub-diagonal, n-1 entries
+    VectorXd diag; // main diagonal, n entries
+    VectorXd upper; // super-diagonal, n-1 entries
+}
+TridiagonalSystem;
+
+// returns K*x using the banded storage, O(n)
+VectorXd tridiagonalMultiply( const TridiagonalSystem &sys, const VectorXd &x );
+
+// direct LU (Thomas algorithm) solver for tridiagonal matrices;
+// the factorization is kept so several right hand sides can be
+// solved against the same matrix in O(n) each
+class TridiagonalSolver
+{
+
+public:
+    TridiagonalSolver();
+    void factorize( const Eigen::Ref<const VectorXd> &lower,
+                    const Eigen::Ref<const VectorXd> &diag,
+                    const Eigen::Ref<const VectorXd> &upper );
+    void solveInPlace( Eigen::Ref<VectorXd> rhs ) const;
+    VectorXd solve( const Eigen::Ref<const VectorXd> &rhs ) const;
+    int size() const;
+
+private:
+    VectorXd multipliers; // unit lower bidiagonal factor L
+    VectorXd invPivots; // reciprocal of diagonal of U
+    VectorXd upperFactor; // super-diagonal of U (same as the matrix)
+};
+
+#endif // TRIDIAGONALSOLVER_H
@@ -0,0 +1,52 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#include "unitsystem.h"
+
+// 1 Btu/hr in W (International Table Btu), 1 ft in m and 1 lb in kg
+static const double BTU_PER_HR = 0.29307107017222;
+static const double FOOT = 0.3048;
+static const double POUND = 0.45359237;
+
+UnitScales unitScalesFor( UnitSystem units )
+{
+    UnitScales s;
+    if (units == UnitSystem::ENGLISH)
+    {
+        s.length = { 1.0/FOOT, 0.0, "ft" };
+        s.temperature = { 1.8, -459.67, "°F" };
+        s.conductivity = { FOOT/(1.8*BTU_PER_HR), 0.0, "Btu/ft·hr·°F" };
+        s.heatGeneration = { FOOT*FOOT*FOOT/BTU_PER_HR, 0.0, "Btu/hr·ft³" };
+        s.heatFlux = { FOOT*FOOT/BTU_PER_HR, 0.0, "Btu/hr·ft²" };
+        s.density = { FOOT*FOOT*FOOT/POUND, 0.0, "lb/ft³" };
+        s.specificHeat = { POUND/(1.8*3600.0*BTU_PER_HR), 0.0, "Btu/lb·°F" };
+    }
+    else // default is SI
+    {
+        s.length = { 1.0, 0.0, "m" };
+        s.temperature = { 1.0, 0.0, "K" };
+        s.conductivity = { 1.0, 0.0, "W/m·K" };
+        s.heatGeneration = { 1.0, 0.0, "W/m³" };
+        s.heatFlux = { 1.0, 0.0, "W/m²" };
+        s.density = { 1.0, 0.0, "kg/m³" };
+        s.specificHeat = { 1.0, 0.0, "J/kg·K" };
+    }
+    return s;
+}
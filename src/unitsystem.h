@@ -0,0 +1,65 @@
+/**
+  *  This file is part of VarmaCalc, Copyright (C)2014 Garret Wassermann.
+  *  Portions of this software include libraries copyright
+  *  the Eigen and KPlotting (KDE) teams.
+  *
+  *  VarmaCalc is free software: you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation, either version 3 of the License, or
+  *  (at your option) any later version.
+  *
+  *  VarmaCalc is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with VarmaCalc.  If not, see <http://www.gnu.org/licenses/>.
+  *
+  */
+
+#ifndef UNITSYSTEM_H
+#define UNITSYSTEM_H
+
+// define which unit system currently using
+enum class UnitSystem
+{
+    SI, ENGLISH
+};
+
+// affine map from SI to a display unit: display = SI*scale + offset
+typedef struct
+{
+    double scale;
+    double offset;
+    const char *symbol; // UTF-8
+}
+UnitConversion;
+
+// conversions for every quantity the model takes or returns,
+// resolved once when the unit system changes
+typedef struct
+{
+    UnitConversion length;
+    UnitConversion temperature;
+    UnitConversion conductivity;
+    UnitConversion heatGeneration;
+    UnitConversion heatFlux;
+    UnitConversion density;
+    UnitConversion specificHeat;
+}
+UnitScales;
+
+UnitScales unitScalesFor( UnitSystem units );
+
+inline double toSI( const UnitConversion &unit, double value )
+{
+    return (value - unit.offset)/unit.scale;
+}
+
+inline double fromSI( const UnitConversion &unit, double value )
+{
+    return value*unit.scale + unit.offset;
+}
+
+#endif // UNITSYSTEM_H